@@ -55,7 +55,7 @@ protected:
 
 	typedef std::unordered_map<unsigned, action*> prototype;
 	static prototype& entries() { static prototype m; return m; }
-	virtual action& reinterpret(const action* a) const { return *new (const_cast<action*>(a)) action(*a); }
+	virtual action& reinterpret(const action* a) const { COUNT_EVENT(reinterpret); return *new (const_cast<action*>(a)) action(*a); }
 
 	unsigned code;
 };
@@ -68,8 +68,17 @@ public:
 	place(int x, int y, unsigned who) : place(board::point(x, y), who) {}
 	place(const board::point& p, unsigned who) : place(p.i, who) {}
 	place(const action& a = {}) : action(a) {}
+	place(const board::move& m) : place(m.position(), m.color()) {}
 	board::point position() const { return board::point(int16_t(event() & 0xffff)); }
 	board::piece_type color() const { return static_cast<board::piece_type>(event() >> 16); }
+	/**
+	 * the compact move of a placing action, or a move of no position if this is not a placing action
+	 */
+	board::move move() const {
+		unsigned t = action::type();
+		if (t != place::type && t != type_flag('B') && t != type_flag('W')) return board::move(-1, board::empty);
+		return board::move(position().i, color());
+	}
 public:
 	board::reward apply(board& b) const { return b.place(position(), color()); }
 	std::ostream& operator >>(std::ostream& out) const {
@@ -92,7 +101,7 @@ public:
 		return in;
 	}
 protected:
-	action& reinterpret(const action* a) const { return *new (const_cast<action*>(a)) place(*a); }
+	action& reinterpret(const action* a) const { COUNT_EVENT(reinterpret); return *new (const_cast<action*>(a)) place(*a); }
 	static __attribute__((constructor)) void init() { entries()[type_flag('p')] = new place; }
 };
 
@@ -104,7 +113,7 @@ public:
 	black(const board::point& p) : action::place(p, board::black) {}
 	black(const action& a = {}) : action::place(a) {}
 protected:
-	action& reinterpret(const action* a) const { return *new (const_cast<action*>(a)) black(*a); }
+	action& reinterpret(const action* a) const { COUNT_EVENT(reinterpret); return *new (const_cast<action*>(a)) black(*a); }
 	static __attribute__((constructor)) void init() { entries()[type_flag('B')] = new black; }
 };
 
@@ -116,6 +125,6 @@ public:
 	white(const board::point& p) : action::place(p, board::white) {}
 	white(const action& a = {}) : action::place(a) {}
 protected:
-	action& reinterpret(const action* a) const { return *new (const_cast<action*>(a)) white(*a); }
+	action& reinterpret(const action* a) const { COUNT_EVENT(reinterpret); return *new (const_cast<action*>(a)) white(*a); }
 	static __attribute__((constructor)) void init() { entries()[type_flag('W')] = new white; }
 };
@@ -9,20 +9,84 @@
 
 #pragma once
 #include <string>
+#include <iostream>
+#include <vector>
 #include <random>
 #include <sstream>
 #include <map>
 #include <type_traits>
 #include <algorithm>
 #include <fstream>
+#include <chrono>
+#include <memory>
+#include <climits>
+#include <limits>
+#include <atomic>
+#include <functional>
+#include <cstring>
+#include <cerrno>
+#if defined(__AVX2__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
 #include <time.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
 #include "board.h"
 #include "action.h"
+#include "network.h"
+#include "endgame.h"
+#include "table.h"
 
 #define CHILDNODESIZE 81
+#define CHILDLANES 84 // CHILDNODESIZE padded to whole vectors of 4 doubles
 #define SIMULATION_TIMES 1000
-#define _b 0.025
+#define BATCH_LIMIT 64 // the maximum batch size, since the buffers of a batch are on the stack
+#define VALUE_SCALE 256 // the value of a win, i.e., the values in the tree are in fixed point
+
+#ifdef PROFILE
+/**
+ * per-move instrumentation of the search, enabled by compiling with -DPROFILE
+ * the time of each phase is measured with steady_clock, in nanoseconds
+ */
+struct profiler {
+	enum phase { selection, expansion, rollout, backup, phases };
+	uint64_t elapsed[phases];
+	uint64_t nodes; // tree nodes visited in selection
+	uint64_t plies; // moves played in rollouts
+	uint64_t probes; // legality probes, i.e., trial placements on a board copy
+
+	profiler() { reset(); }
+	void reset() { std::fill(elapsed, elapsed + phases, 0); nodes = plies = probes = 0; }
+
+	/**
+	 * measure the time of a phase in the enclosing scope
+	 */
+	struct scope {
+		profiler& prof;
+		phase ph;
+		std::chrono::steady_clock::time_point start;
+		scope(profiler& prof, phase ph) : prof(prof), ph(ph), start(std::chrono::steady_clock::now()) {}
+		~scope() { prof.elapsed[ph] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(); }
+	};
+
+	/**
+	 * print as one JSON object per line, with the time of each phase in microseconds
+	 */
+	void emit(std::ostream& out, const std::string& name, size_t ply, size_t simulations) const {
+		const char* label[] = { "selection", "expansion", "rollout", "backup" };
+		out << "{\"player\":\"" << name << "\",\"turn\":" << ply << ",\"simulations\":" << simulations;
+		for (int i = 0; i < phases; i++) out << ",\"" << label[i] << "_us\":" << (elapsed[i] / 1000.0);
+		out << ",\"nodes\":" << nodes << ",\"plies\":" << plies << ",\"probes\":" << probes << "}" << std::endl;
+	}
+};
+#define PROFILE_PHASE(ph) profiler::scope profile_scope(prof, profiler::ph)
+#define PROFILE_COUNT(field, n) (prof.field += (n))
+#else
+#define PROFILE_PHASE(ph)
+#define PROFILE_COUNT(field, n)
+#endif
 
 class agent {
 public:
@@ -80,9 +144,23 @@ protected:
  */
 class player : public random_agent {
 public:
+	/**
+	 * the statistics of the children of an expanded node in structure-of-arrays style, aligned for
+	 * the vectorized selection, where the values are sums in VALUE_SCALE per win, kept in double since
+	 * the RAVE sums grow with the depth, and 'spread' is the sum of the squares of the running value
+	 * sums, i.e., the variance term of UCB_Tuned
+	 */
+	struct alignas(32) stats_t {
+		double spread[CHILDLANES], val[CHILDLANES], rave_val[CHILDLANES];
+		int count[CHILDLANES], rave_count[CHILDLANES];
+		int pending[CHILDLANES]; // number of selected leaves below each child waiting in a batch
+		float prior[CHILDLANES]; // the move probabilities of the policy head of eval=nn, or 0
+		uint64_t legal[2]; // whether each child is a legal move, cached by the expansion
+	};
+
 	typedef struct node {
-		struct node *child[CHILDNODESIZE];
-		int count, *val, rave_count, *rave_val;
+		struct node *child[CHILDNODESIZE]; // allocated when first selected, or null
+		stats_t *stats; // the statistics of the children, or null if not expanded
 		bool isLeaf;
 		board::piece_type color;
 	} node_t;
@@ -96,31 +174,159 @@ public:
 		if (who == board::empty)
 			throw std::invalid_argument("invalid role: " + role());
 		for (size_t i = 0; i < space.size(); i++)
-			space[i] = action::place(i, who);
+			space[i] = board::move(i, who);
         srand(time(NULL));
-        if (search() == "MCTS")
-            simulation_times = stoi(sim_time());
+        if (search() == "MCTS") // the number of simulations is unbounded if only the time is limited
+            simulation_times = meta.count("simulation") || !meta.count("timeout") ? stoi(sim_time()) : INT_MAX;
+		if (meta.find("eval") != meta.end() && property("eval") == "nn") {
+			if (meta.find("weights") == meta.end())
+				throw std::invalid_argument("eval=nn requires weights=");
+			net = network::load(property("weights"));
+			blend = meta.find("blend") != meta.end() ? double(meta["blend"]) : 1.0;
+			bias = meta.find("prior") != meta.end() ? double(meta["prior"]) : 1.0;
+		}
+		if (meta.find("batch") != meta.end())
+			batch = std::min(std::max(int(meta["batch"]), 1), BATCH_LIMIT);
+		if (meta.find("flush") != meta.end())
+			flush = meta["flush"];
+		if (meta.find("endgame") != meta.end())
+			solver = endgame(int(meta["endgame"]));
+		if (meta.find("rave") != meta.end())
+			rave_b = meta["rave"];
+		if (meta.find("explore") != meta.end())
+			explore = meta["explore"];
+		if (meta.find("expand") != meta.end())
+			expansion = std::max(int(meta["expand"]), 1);
+		if (meta.find("nodes") != meta.end())
+			search_nodes = analyze_nodes = std::max(int(meta["nodes"]), 1);
+		for (board::piece_type color : { board::black, board::white }) {
+			node_t& f = frontier[color == board::black ? 0 : 1];
+			std::fill(f.child, f.child + CHILDNODESIZE, nullptr);
+			f.stats = nullptr;
+			f.isLeaf = true;
+			f.color = color;
+		}
+		if (meta.find("helpers") != meta.end())
+			helpers = std::max(int(meta["helpers"]), 0);
+		if (helpers) { // fork the helpers now, since a process with other threads cannot be forked safely
+			if (threads() > 1)
+				throw std::invalid_argument("helpers= requires the player to be created before any other thread starts");
+			table.reset(new shared_table(meta.find("tt") != meta.end() ? int(meta["tt"]) : 16));
+			for (int k = 0; k < helpers; ++k)
+				crew.push_back(hire());
+		}
+		leaves.resize(batch);
+#ifdef PROFILE
+		if (meta.find("profile") != meta.end() && property("profile") != "stderr")
+			prof_out.reset(new std::ofstream(property("profile"), std::ios::out | std::ios::app));
+#endif
+	}
+
+	/**
+	 * check the arguments of a player as the constructor does, without creating it, so that no helper
+	 * is forked; a mode that creates its players on other threads, e.g., "--sweep", refuses helpers=
+	 */
+	static void check(const std::string& args, const std::string& mode = "") {
+		std::map<std::string, std::string> meta = { { "name", "random" }, { "role", "unknown" } };
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; )
+			meta[pair.substr(0, pair.find('='))] = pair.substr(pair.find('=') + 1);
+		if (meta["name"].find_first_of("[]():; ") != std::string::npos)
+			throw std::invalid_argument("invalid name: " + meta["name"]);
+		if (meta["role"] != "black" && meta["role"] != "white")
+			throw std::invalid_argument("invalid role: " + meta["role"]);
+		for (const char* key : { "seed", "simulation", "timeout", "blend", "prior", "batch", "flush", "endgame",
+		                         "rave", "explore", "expand", "nodes", "helpers", "tt" }) {
+			try {
+				if (meta.count(key)) std::stod(meta[key]);
+			} catch (const std::exception&) {
+				throw std::invalid_argument("invalid " + std::string(key) + ": " + meta[key]);
+			}
+		}
+		if (meta.count("search") && meta["search"] == "MCTS" && !meta.count("simulation") && !meta.count("timeout"))
+			throw std::invalid_argument("search=MCTS requires simulation= or timeout=");
+		if (meta.count("eval") && meta["eval"] == "nn") {
+			if (!meta.count("weights"))
+				throw std::invalid_argument("eval=nn requires weights=");
+			network::load(meta["weights"]);
+		}
+		if (meta.count("helpers") && std::stod(meta["helpers"]) >= 1 && mode.size())
+			throw std::invalid_argument("helpers= is not supported with " + mode + ", which starts other threads before creating its players");
+	}
+
+	virtual ~player() {
+		for (const helper& h : crew) {
+			close(h.cmd), close(h.done);
+			kill(h.pid, SIGTERM);
+			waitpid(h.pid, nullptr, 0);
+		}
+	}
+
+	virtual void open_episode(const std::string& flag = "") {
+		ply = 0;
+		meta.erase("budget"); // a clock budget belongs to the episode it is given in
+		if (table) table->clear();
 	}
 
     double beta(int count, int rave_count) {
-        return rave_count / (rave_count + count + 4 * (double) rave_count * (double) count * pow((_b), 2));
+        return rave_count / (rave_count + count + 4 * (double) rave_count * (double) count * pow(rave_b, 2));
     }
 
+	/**
+	 * the statistics of the last search
+	 */
+	struct search_report {
+		size_t simulations; // number of played sequences
+		size_t nodes; // number of visited tree nodes
+		int visits[CHILDNODESIZE]; // visit count of each child of the root, by position
+		float values[CHILDNODESIZE]; // mean value of each visited child of the root for this player, by position
+		size_t evaluations; // number of network evaluations
+		size_t eval_nanos; // total latency of the network evaluations
+		size_t batches; // number of evaluated batches, with batch=
+		size_t batched; // number of leaves in the batches, i.e., the occupancy is batched / (batches * batch)
+		size_t collisions; // number of batches closed by selecting a pending leaf
+		bool solved; // whether the move is decided by the endgame analyzer without searching
+		size_t shared; // number of visits of the root children over all processes, with helpers=
+		double winrate; // the value of the chosen move for this player, or 0 if no move is searched or solved
+	};
+	const search_report& report() const { return recent; }
+
+	/**
+	 * let the next search give each of the given moves at least the given share of the root visits, by
+	 * sequences forced through the move after the search, so that the values of the moves, e.g., of a
+	 * reviewed game, are compared within one tree; the moves only apply to the next search
+	 */
+	void force(const std::vector<int>& moves, double share) {
+		forcing = moves;
+		forcing_share = share;
+	}
+
+	/**
+	 * stop the current search as soon as possible, so that the best move so far is played
+	 * the flag stays until it is cleared, so it also stops a search that has not yet begun
+	 */
+	void interrupt(bool halt = true) { halted.store(halt, std::memory_order_relaxed); }
+
 	virtual action take_action(const board& state) {
+		recent = {};
+		std::vector<int> moves; // the moves of force(), which only apply to this search
+		moves.swap(forcing);
+		ply++;
 		if (search() == "Random") {
 			std::shuffle(space.begin(), space.end(), engine);
-			for (const action::place& move : space) {
+			for (const board::move& move : space) {
 				board after = state;
-				if (move.apply(after) == board::legal)
-					return move;
+				if (after.place(move) == board::legal)
+					return action::place(move);
 			}
 			return action();
 		} else if (search() == "MCTS") {
             // if no legal move just return
             bool flag = false;
-			for (const action::place& move : space) {
+			for (const board::move& move : space) {
 				board after = state;
-				if (move.apply(after) == board::legal) {
+				PROFILE_COUNT(probes, 1);
+				if (after.place(move) == board::legal) {
                     flag = true;
                     break;
                 }
@@ -128,16 +334,77 @@ public:
             if (!flag)
                 return action();
 
+			// play the exact move if every region of the board is solved
+			double total;
+			board::move exact = solver.choose(state, &total);
+			if (exact.position() != -1) {
+				recent.solved = true;
+				recent.winrate = (who == board::black ? total > 0 : total < 0) ? 1 : 0;
+				return action::place(exact);
+			}
+
+			// the search stops at the deadline if a time limit in milliseconds is given, which is either the budget
+			// of this move from the game clock, notified as 'budget' and used once, or the fixed 'timeout' per move
+			// a clock budget replaces the number of simulations, so that a generous clock buys a longer search,
+			// and a zero budget, e.g., for a forced move or an exhausted clock, plays a random legal move at once
+			auto deadline = std::chrono::steady_clock::time_point::max();
+			int limit = simulation_times;
+			if (meta.count("budget") || meta.count("timeout")) {
+				int timeout = meta.count("budget") ? meta["budget"] : meta["timeout"];
+				if (meta.count("budget")) limit = INT_MAX;
+				meta.erase("budget");
+				if (timeout <= 0) {
+					std::shuffle(space.begin(), space.end(), engine);
+					for (const board::move& move : space) {
+						board after = state;
+						if (after.place(move) == board::legal) return action::place(move);
+					}
+				}
+				deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+			}
+
             // create root of MCTS tree
-			node_t *root = (node_t *) malloc (sizeof(node_t));
-			root->isLeaf = true;
-			root->count = root->rave_count = 0;
-			root->color = who;
-            // root count = 1000, 1024 becuase * 2
-            root->val = (int *) malloc (sizeof(int) * 1024);
-            root->rave_val = (int *) malloc (sizeof(int) * 1024);
-			for (int i = 0; i < simulation_times; ++i)
-				playOneSequence(root, state);
+			node_t *root = new_root(search_nodes);
+			root_key = salted(state);
+#ifdef PROFILE
+			prof.reset();
+#endif
+			dispatch(state, deadline, limit);
+			playUntil(root, state, deadline, limit);
+			join();
+			for (bool more = moves.size(); more; ) { // until no move falls below its share of the grown root
+				more = false;
+				for (int move : moves) more |= visit(root, state, move, forcing_share);
+			}
+#ifdef PROFILE
+			prof.emit(prof_out ? *prof_out : std::cerr, name(), ply, recent.simulations);
+#endif
+			const stats_t& s = *root->stats;
+			for (int i = 0; i < CHILDNODESIZE; ++i) {
+				recent.visits[i] = s.count[i];
+				recent.values[i] = s.count[i] ? (double) s.val[i] / VALUE_SCALE / s.count[i] : 0;
+			}
+
+			if (crew.size()) { // play the most visited child over all processes, i.e., of this tree and the share of the helpers
+				int best = -1;
+				uint64_t most = 0;
+				for (int i = 0; i < CHILDNODESIZE; ++i) {
+					if (!(s.legal[i >> 6] >> (i & 63) & 1)) continue;
+					uint32_t count = 0;
+					uint64_t value = 0;
+					table->find(root_key ^ board::zobrist(i, who), count, value);
+					recent.shared += count;
+					uint64_t total = s.count[i] + count;
+					if (total > most) {
+						best = i, most = total;
+						recent.winrate = (s.val[i] + value) / VALUE_SCALE / total;
+					}
+				}
+				if (best != -1) {
+					free_tree(root);
+					return action::place(best, who);
+				}
+			}
             
             // shuffle index to choose random move
             std::vector<int> indexs;
@@ -146,23 +413,25 @@ public:
             std::shuffle(indexs.begin(), indexs.end(), engine);
 
 			int index = 0;
-            while (!(root->child[indexs[index]]->count))
+            while (!(s.count[indexs[index]]))
                 index += 1;
 	    for (int i = index + 1; i < CHILDNODESIZE; ++i) {
-                int count = root->child[indexs[i]]->count;
+                int count = s.count[indexs[i]];
 		if (!count)
 			continue;
-                int value = root->child[indexs[i]]->val[count - 1];
-                int max_count = root->child[indexs[index]]->count;
-                int max_value = root->child[indexs[index]]->val[max_count - 1];
-                int rave_count = root->child[indexs[i]]->rave_count;
-                int rave_value = root->child[indexs[i]]->rave_val[rave_count - 1];
-                int max_rave_count = root->child[indexs[index]]->rave_count;
-                int max_rave_value = root->child[indexs[index]]->rave_val[max_rave_count - 1];
-                if (root->child[indexs[i]]->count)
+                double value = s.val[indexs[i]];
+                int max_count = s.count[indexs[index]];
+                double max_value = s.val[indexs[index]];
+                int rave_count = s.rave_count[indexs[i]];
+                double rave_value = s.rave_val[indexs[i]];
+                int max_rave_count = s.rave_count[indexs[index]];
+                double max_rave_value = s.rave_val[indexs[index]];
+                if (count)
     				index = (1 - beta(count, rave_count)) * (double) value  / count + beta(count, rave_count) * (double) rave_value / rave_count > (1 - beta(max_count, max_rave_count)) * (double) max_value  / max_count + beta(max_count, max_rave_count) * (double) max_rave_value / max_rave_count ? i : index;
             }
 
+			recent.winrate = (double) s.val[indexs[index]] / VALUE_SCALE / s.count[indexs[index]];
+
             // clear MCTS search tree
             free_tree(root);
 
@@ -179,137 +448,470 @@ public:
 		return action();
 	}
 
+	/**
+	 * the key of the root of a new search, where the hash of the state is salted by the number of
+	 * searches, so that the table only holds the statistics of the current search
+	 */
+	uint64_t salted (const board& state) {
+		return table ? state.hash() ^ (++searches * 0x9e3779b97f4a7c15ull) : 0;
+	}
+
+	/**
+	 * play sequences from the root until the given number of simulations, the deadline, or an interrupt
+	 */
+	void playUntil (node_t *root, const board& state, std::chrono::steady_clock::time_point deadline, int limit) {
+		for (int i = 0; i < limit; ) {
+			// at least two sequences are needed to visit a child of the root
+			if (i >= 2 && (halted.load(std::memory_order_relaxed) || std::chrono::steady_clock::now() >= deadline)) break;
+			i += playBatch(root, state, std::min(batch, limit - i));
+		}
+	}
+
+	/**
+	 * play sequences through a legal child of the root until it has the given share of the root visits
+	 * return whether any sequence is played
+	 */
+	bool visit(node_t *root, const board& state, int move, double share) {
+		if (root->isLeaf || !(root->stats->legal[move >> 6] >> (move & 63) & 1)) return false;
+		const stats_t& s = *root->stats;
+		int total = 0, played = 0;
+		for (int i = 0; i < CHILDNODESIZE; ++i) total += s.count[i];
+		forced = move;
+		while (s.count[move] < share * total && !halted.load(std::memory_order_relaxed)) {
+			int n = playBatch(root, state, 1);
+			if (n == 0) break;
+			total += n, played += n;
+		}
+		forced = -1;
+		return played;
+	}
+
+	/**
+	 * a helper process of helpers=, forked when the player is created, which searches each state
+	 * sent through its command pipe with its own tree and seed, writes its statistics to the table,
+	 * and reports the end of each search through its done pipe
+	 */
+	struct helper {
+		pid_t pid;
+		int cmd, done; // the write end of the commands and the read end of the reports
+	};
+
+	/**
+	 * a search for the helpers
+	 */
+	struct job {
+		board::grid stone; // the state, without the board itself, whose copies may be counted
+		board::data info;
+		uint64_t key; // the key of the root, shared with this process
+		std::chrono::steady_clock::time_point deadline;
+		int limit;
+		unsigned seed;
+	};
+	static_assert(std::is_trivially_copyable<job>::value, "a job is sent through a pipe as bytes");
+
+	/**
+	 * the number of threads of this process, or 1 if unknown
+	 */
+	static size_t threads() {
+		std::ifstream in("/proc/self/status");
+		for (std::string line; std::getline(in, line); )
+			if (line.find("Threads:") == 0) return std::stoul(line.substr(8));
+		return 1;
+	}
+
+	/**
+	 * fork a helper, which serves the searches until its command pipe is closed
+	 */
+	helper hire () {
+		int cmd[2], done[2];
+		if (pipe(cmd) != 0) throw std::runtime_error("pipe failed");
+		if (pipe(done) != 0) throw std::runtime_error("pipe failed");
+		std::cout.flush(), std::cerr.flush();
+		pid_t pid = fork();
+		if (pid < 0) throw std::runtime_error("fork failed");
+		if (pid == 0) { // in the helper
+			close(cmd[1]), close(done[0]);
+			assist(cmd[0], done[1]);
+			_exit(0);
+		}
+		close(cmd[0]), close(done[1]);
+		return { pid, cmd[1], done[0] };
+	}
+
+	/**
+	 * the loop of a helper, where SIGUSR1 interrupts the current search
+	 */
+	void assist (int in, int out) {
+		static std::atomic<bool>* stop = nullptr;
+		stop = &halted;
+		struct sigaction act;
+		std::memset(&act, 0, sizeof(act));
+		act.sa_handler = [](int) { stop->store(true, std::memory_order_relaxed); };
+		act.sa_flags = SA_RESTART;
+		sigaction(SIGUSR1, &act, nullptr);
+		crew.clear(); // the helpers of this player belong to the parent
+		helping = true;
+		for (job j; transfer(in, &j, sizeof(j), read); ) {
+			halted.store(false, std::memory_order_relaxed);
+			engine.seed(j.seed);
+			root_key = j.key;
+			node_t *root = new_root(search_nodes);
+			playUntil(root, board(j.stone, j.info), j.deadline, j.limit);
+			free_tree(root);
+			char end = 0;
+			if (!transfer(out, &end, 1, write)) break;
+		}
+	}
+
+	/**
+	 * read or write a whole buffer through a pipe, return false if the other end is closed
+	 */
+	template<typename io_t, typename buf_t>
+	static bool transfer (int fd, buf_t* buf, size_t size, io_t io) {
+		for (size_t n = 0; n < size; ) {
+			ssize_t k = io(fd, reinterpret_cast<char*>(buf) + n, size - n);
+			if (k < 0 && errno == EINTR) continue;
+			if (k <= 0) return false;
+			n += k;
+		}
+		return true;
+	}
+
+	/**
+	 * send the search of a state to the helpers, where a helper that has exited is dismissed
+	 */
+	void dispatch (const board& state, std::chrono::steady_clock::time_point deadline, int limit) {
+		for (size_t k = 0; k < crew.size(); ) {
+			helper& h = crew[k];
+			job j = { state, state.info(), root_key, deadline, limit, unsigned(engine()) };
+			if (waitpid(h.pid, nullptr, WNOHANG) == 0 && transfer(h.cmd, &j, sizeof(j), write)) {
+				k++;
+				continue;
+			}
+			close(h.cmd), close(h.done);
+			crew.erase(crew.begin() + k);
+		}
+	}
+
+	/**
+	 * wait for the helpers to finish the search, which are interrupted at once if this search is interrupted
+	 */
+	void join () {
+		for (const helper& h : crew) {
+			if (halted.load(std::memory_order_relaxed)) kill(h.pid, SIGUSR1);
+			char end;
+			transfer(h.done, &end, 1, read);
+		}
+	}
+
+	/**
+	 * the search result of a child of the root, from the view of this player
+	 */
+	struct child_report {
+		int move; // position of the child
+		int visits;
+		double winrate; // mean value of the simulations through the child
+		double rave; // mean value of the simulations containing the move, i.e., the RAVE value
+		std::vector<int> pv; // the principal variation beginning with the move, by the most visited children
+	};
+
+	/**
+	 * search the state until interrupted, and report the visited children of the root,
+	 * ordered by their visits, every interval milliseconds
+	 * the state is searched as if this player is to move
+	 * the tree stops growing at the node limit of 'nodes', 100000 by default, after which the simulations
+	 * only refine the statistics of the existing nodes, so that a long analysis does not exhaust the memory
+	 */
+	void analyze(board state, time_t interval, const std::function<void(const std::vector<child_report>&)>& emit) {
+		board::data turn = state.info();
+		turn.who_take_turns = who;
+		state.info(turn);
+		if (isEndBoard(state, who)) return;
+		recent = {};
+		node_t *root = new_root(analyze_nodes);
+		root_key = salted(state);
+		auto next = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+		for (int i = 0; i < 2 || !halted.load(std::memory_order_relaxed); ) {
+			i += playBatch(root, state, batch);
+			if (i >= 2 && std::chrono::steady_clock::now() >= next) {
+				emit(children(root));
+				next = std::chrono::steady_clock::now() + std::chrono::milliseconds(interval);
+			}
+		}
+		free_tree(root);
+	}
+
+	std::vector<child_report> children(node_t *root) const {
+		std::vector<child_report> list;
+		for (int i = 0; i < CHILDNODESIZE && !root->isLeaf; ++i) {
+			const stats_t& s = *root->stats;
+			if (!s.count[i]) continue;
+			child_report child = { i, s.count[i],
+				(double) s.val[i] / VALUE_SCALE / s.count[i],
+				(double) s.rave_val[i] / VALUE_SCALE / s.rave_count[i], { i } };
+			const node_t *node = root->child[i];
+			while (node && !node->isLeaf) {
+				int move = -1;
+				for (int j = 0; j < CHILDNODESIZE; ++j)
+					if (node->stats->count[j] && (move == -1 || node->stats->count[j] > node->stats->count[move]))
+						move = j;
+				if (move == -1) break;
+				child.pv.push_back(move);
+				node = node->child[move];
+			}
+			list.push_back(child);
+		}
+		std::stable_sort(list.begin(), list.end(),
+			[](const child_report& a, const child_report& b) { return a.visits > b.visits; });
+		return list;
+	}
+
 	unsigned my_close_episode(const std::string& flag = "") {
 		return flag == "black" ? 1u : 2u;
 	}
 
     double UCB (int val, int count, int total) {
-        return (double) val / count + pow(2 * log10(total) / count, 0.5);
+        return (double) val / VALUE_SCALE / count + pow(2 * log10(total) / count, 0.5);
     }
 
-    double UCB_Tuned (node_t *node, int total) {
-        double mean =  (double) node->val[node->count - 1] / node->count;
-        double rave_mean =  (double) node->rave_val[node->rave_count - 1] / node->rave_count;
-        double value = - pow(mean, 2) + pow(2 * log10(total) / node->count, 0.5);
-        double sum = 0;
-        for (int i = 0; i < node->count; ++i)
-            sum += pow(node->val[i], 2);
-        sum /= node->count;
-        value += sum;
+    double UCB_Tuned (const stats_t& s, int i, double logTotal, bool mine) {
+        // the pending visits of a batch are counted as losses of the side choosing this child, i.e., virtual losses
+        int count = s.count[i] + s.pending[i];
+        double wins = (double) s.val[i] / VALUE_SCALE + (mine ? s.pending[i] : 0);
+        double mean =  wins / count;
+        double rave_mean =  s.rave_count[i] ? (double) s.rave_val[i] / VALUE_SCALE / s.rave_count[i] : mean;
+        double value = - mean * mean + sqrt(2 * logTotal / count);
+        value += s.spread[i] / count;
         double min = 0.25 < value ? 0.25 : value;
-        return (1 - beta(node->count, node->rave_count)) * mean + beta(node->count, node->rave_count) * rave_mean + pow(log10(total) * min / node->count, 0.5);
+        return (1 - beta(count, s.rave_count[i])) * mean + beta(count, s.rave_count[i]) * rave_mean + explore * sqrt(logTotal * min / count);
     }
 
-	node_t *select (node_t *parent, board& presentBoard, board::piece_type color) {
+	/**
+	 * select a child of an expanded node, and play it on the board, return its position
+	 *
+	 * this player takes the child of the maximum UCB, and the opponent takes the minimum, where an
+	 * unvisited legal child comes first; the ties are broken uniformly at random
+	 */
+	int select (node_t *parent, board& presentBoard, board::piece_type color) {
+		const stats_t& s = *parent->stats;
+		bool own = parent->color == color;
+		uint64_t ties[2];
+#if defined(__AVX2__) || defined(__x86_64__)
+		if (avx2())
+			best_avx2(s, own, ties);
+		else
+#endif
+			best(s, own, ties);
+		if (!(ties[0] | ties[1])) { // all scores are NaN
+			ties[0] = s.legal[0];
+			ties[1] = s.legal[1];
+		}
+
+		int n = __builtin_popcountll(ties[0]) + __builtin_popcountll(ties[1]);
+		int r = n > 1 ? std::uniform_int_distribution<int>(0, n - 1)(engine) : 0;
+		int w = r < __builtin_popcountll(ties[0]) ? 0 : 1;
+		if (w) r -= __builtin_popcountll(ties[0]);
+		uint64_t bits = ties[w];
+		for (; r; --r) bits &= bits - 1; // drop the r lowest ties
+		int i = w * 64 + __builtin_ctzll(bits);
+
+		presentBoard.setBoard(i, parent->color);
+        // change turn
+        presentBoard.change_turn();
+		return i;
+	}
+
+	/**
+	 * the children of the best score, where the score is the UCB for this player and its negation for
+	 * the opponent, an unvisited legal child scores 1e300 and 0 respectively, and an illegal child
+	 * scores -1 and -1.2e308; the log of the total count is shared by all children
+	 *
+	 * with a policy prior, a legal child also gets the progressive bias prior / (count + 1) weighted by
+	 * 'prior', and the unvisited children of this player score 1e300 times one plus it, so that they are
+	 * tried in the order of the policy
+	 */
+	void best (const stats_t& s, bool own, uint64_t ties[2]) {
 		int total = 0;
-		double v[CHILDNODESIZE] = {0.0};
-        // calculate total count 
 		for (int i = 0; i < CHILDNODESIZE; ++i)
-			total += parent->child[i]->count;
+			total += s.count[i] + s.pending[i];
+		double logTotal = log10(total);
 
-        // calculate each UCB of childs' node
+		double v[CHILDNODESIZE], max = -INFINITY;
 		for (int i = 0; i < CHILDNODESIZE; ++i) {
-			board after = presentBoard;
-			if (action::place(i, parent->color).apply(after) == board::legal) {
-				if (parent->color == color)
-					v[i] = parent->child[i]->count == 0 ? 1e308 : UCB_Tuned(parent->child[i], total);
-				else
-					v[i] = parent->child[i]->count == 0 ? 0 : UCB_Tuned(parent->child[i], total);
+			if (s.legal[i >> 6] >> (i & 63) & 1) {
+				int count = s.count[i] + s.pending[i];
+				double prior = bias * s.prior[i] / (count + 1);
+				v[i] = count == 0 ? (own ? 1e300 * (1 + prior) : prior) : (own ? 1 : -1) * UCB_Tuned(s, i, logTotal, !own) + prior;
 			} else
-				v[i] = parent->color == color ? -1 : 1.2e308;
+				v[i] = own ? -1 : -1.2e308;
+			max = std::max(max, v[i]);
 		}
+		ties[0] = ties[1] = 0;
+		for (int i = 0; i < CHILDNODESIZE; ++i)
+			if (v[i] == max) ties[i >> 6] |= 1ull << (i & 63);
+		ties[0] &= s.legal[0];
+		ties[1] &= s.legal[1];
+	}
 
-        // shuffle index to choose random child
-        std::vector<int> indexs;
-        for (int i = 0; i < CHILDNODESIZE; ++i)
-            indexs.push_back(i);
-        std::shuffle(indexs.begin(), indexs.end(), engine);
+#if defined(__AVX2__) || defined(__x86_64__)
+	/**
+	 * the vectorized version of best, which scores 4 children at a time, only built for x86
+	 */
+	__attribute__((target("avx2,fma")))
+	void best_avx2 (const stats_t& s, bool own, uint64_t ties[2]) {
+		__m128i sum = _mm_setzero_si128();
+		for (int i = 0; i < CHILDLANES; i += 4)
+			sum = _mm_add_epi32(sum, _mm_add_epi32(_mm_load_si128((const __m128i*) &s.count[i]), _mm_load_si128((const __m128i*) &s.pending[i])));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		const __m256d logTotal = _mm256_set1_pd(log10(_mm_cvtsi128_si32(sum)));
 
-		int i = 0;
-        while (parent->color == color && v[indexs[i]] == -1.0)
-            i += 1;
-        while (parent->color != color && v[indexs[i]] == 1.2e308)
-            i += 1;
-		for (int j = i + 1; j < CHILDNODESIZE; ++j) {
-            // choose max value when match color otherwise min value
-			if (parent->color == color)
-				i = v[indexs[j]] > v[indexs[i]] ? j : i;
-			else
-				i = v[indexs[j]] < v[indexs[i]] ? j : i;
+		const __m256d scale = _mm256_set1_pd(1.0 / VALUE_SCALE), zero = _mm256_setzero_pd(), one = _mm256_set1_pd(1);
+		const __m256d two = _mm256_set1_pd(2), quarter = _mm256_set1_pd(0.25), b2 = _mm256_set1_pd(4 * rave_b * rave_b);
+		const __m256d sign = _mm256_set1_pd(own ? 1 : -1), mine = own ? zero : one, c = _mm256_set1_pd(explore);
+		const __m256d big = _mm256_set1_pd(1e300), weight = _mm256_set1_pd(bias), illegal = _mm256_set1_pd(own ? -1 : -1.2e308);
+		const __m256i bit = _mm256_set_epi64x(8, 4, 2, 1);
+		alignas(32) double v[CHILDLANES];
+		__m256d max = _mm256_set1_pd(-INFINITY);
+		for (int i = 0; i < CHILDLANES; i += 4) {
+			__m256d pending = _mm256_cvtepi32_pd(_mm_load_si128((const __m128i*) &s.pending[i]));
+			__m256d count = _mm256_add_pd(_mm256_cvtepi32_pd(_mm_load_si128((const __m128i*) &s.count[i])), pending);
+			__m256d wins = _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(&s.val[i]), scale), _mm256_mul_pd(pending, mine));
+			__m256d mean = _mm256_div_pd(wins, count);
+			__m256d rave_count = _mm256_cvtepi32_pd(_mm_load_si128((const __m128i*) &s.rave_count[i]));
+			__m256d rave_mean = _mm256_div_pd(_mm256_mul_pd(_mm256_load_pd(&s.rave_val[i]), scale), rave_count);
+			rave_mean = _mm256_blendv_pd(rave_mean, mean, _mm256_cmp_pd(rave_count, zero, _CMP_EQ_OQ));
+			__m256d value = _mm256_sub_pd(_mm256_sqrt_pd(_mm256_div_pd(_mm256_mul_pd(two, logTotal), count)), _mm256_mul_pd(mean, mean));
+			value = _mm256_add_pd(value, _mm256_div_pd(_mm256_load_pd(&s.spread[i]), count));
+			__m256d min = _mm256_min_pd(value, quarter);
+			__m256d beta = _mm256_div_pd(rave_count, _mm256_add_pd(_mm256_add_pd(rave_count, count), _mm256_mul_pd(_mm256_mul_pd(rave_count, count), b2)));
+			__m256d ucb = _mm256_add_pd(_mm256_mul_pd(_mm256_sub_pd(one, beta), mean), _mm256_mul_pd(beta, rave_mean));
+			ucb = _mm256_add_pd(ucb, _mm256_mul_pd(c, _mm256_sqrt_pd(_mm256_div_pd(_mm256_mul_pd(logTotal, min), count))));
+			__m256d prior = _mm256_div_pd(_mm256_mul_pd(_mm256_cvtps_pd(_mm_load_ps(&s.prior[i])), weight), _mm256_add_pd(count, one));
+			ucb = _mm256_add_pd(_mm256_mul_pd(ucb, sign), prior);
+			__m256d unvisited = own ? _mm256_mul_pd(big, _mm256_add_pd(one, prior)) : prior;
+			ucb = _mm256_blendv_pd(ucb, unvisited, _mm256_cmp_pd(count, zero, _CMP_EQ_OQ));
+			__m256i legal = _mm256_and_si256(_mm256_set1_epi64x(s.legal[i >> 6] >> (i & 63)), bit);
+			ucb = _mm256_blendv_pd(illegal, ucb, _mm256_castsi256_pd(_mm256_cmpeq_epi64(legal, bit)));
+			_mm256_store_pd(&v[i], ucb);
+			max = _mm256_max_pd(max, ucb);
 		}
-		presentBoard.setBoard(indexs[i], parent->color);
+		max = _mm256_max_pd(max, _mm256_permute2f128_pd(max, max, 1));
+		max = _mm256_max_pd(max, _mm256_permute_pd(max, 5));
+		ties[0] = ties[1] = 0;
+		for (int i = 0; i < CHILDLANES; i += 4)
+			ties[i >> 6] |= uint64_t(_mm256_movemask_pd(_mm256_cmp_pd(_mm256_load_pd(&v[i]), max, _CMP_EQ_OQ))) << (i & 63);
+		ties[0] &= s.legal[0];
+		ties[1] &= s.legal[1];
+	}
 
-        int tmp = indexs[i];
-        indexs.clear();
+	static bool avx2() {
+		static const bool support = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		return support;
+	}
+#endif
 
-        // change turn
-        presentBoard.change_turn();
+	node_t *new_node (board::piece_type color) {
+		node_t *node = (node_t *) malloc (sizeof(node_t));
+		COUNT_EVENT(node_alloc);
+		allocated++;
+		std::fill(node->child, node->child + CHILDNODESIZE, nullptr);
+		node->stats = nullptr;
+		node->isLeaf = true;
+		node->color = color;
+		return node;
+	}
 
-		return parent->child[tmp];
+	/**
+	 * the root of a new search, whose tree grows up to the given number of nodes
+	 */
+	node_t *new_root (size_t limit) {
+		allocated = 0;
+		node_limit = limit;
+		return new_node(who);
 	}
 
-	void updateValue (node_t *selectNode[CHILDNODESIZE], int value, int last, bool isEndBoard) {
-		node_t *p = selectNode[last];
+	/**
+	 * expand a leaf whose state is given, where the legal moves are cached in the statistics,
+	 * and the children are allocated when they are first selected
+	 */
+	void expand (node_t *p, const board& presentBoard, uint64_t key) {
+		p->isLeaf = false;
+		p->stats = (stats_t *) aligned_alloc (alignof(stats_t), sizeof(stats_t));
+		COUNT_EVENT(stats_alloc);
+		memset(p->stats, 0, sizeof(stats_t));
+		for (int i = 0; i < CHILDNODESIZE; ++i) {
+			board after = presentBoard;
+			PROFILE_COUNT(probes, 1);
+			if (after.place(board::move(i, p->color)) == board::legal)
+				p->stats->legal[i >> 6] |= 1ull << (i & 63);
+		}
+		if (net && bias) // the policy of the side to move at the node, i.e., its color
+			net->policy(presentBoard, p->stats->prior);
+		if (table && !helping && key != root_key) { // start the children from the share of the helpers, which the root counts by itself
+			for (int i = 0; i < CHILDNODESIZE; ++i) {
+				uint32_t count;
+				uint64_t value;
+				if (p->stats->legal[i >> 6] >> (i & 63) & 1 && table->find(key ^ board::zobrist(i, p->color), count, value))
+					seed(*p->stats, i, count, value);
+			}
+		}
+	}
 
-        // store every move in selected path 
-        int move[last];
+	/**
+	 * set the statistics of a child from the visits of the helpers as if they had the same value, where
+	 * the count is limited so that the sums fit; the RAVE statistics are left to the visits of this tree
+	 */
+	void seed (stats_t& s, int i, uint64_t count, uint64_t value) {
+		const uint64_t limit = 1 << 16;
+		if (count > limit) {
+			value = value * limit / count;
+			count = limit;
+		}
+		double mean = (double) value / VALUE_SCALE / count;
+		s.count[i] = count;
+		s.val[i] = value;
+		s.spread[i] = mean * mean * count * (count + 1) * (2 * count + 1) / 6; // the sum of (mean * k)^2 for k = 1 to count
+	}
 
-        if (!isEndBoard) {
-		    p->isLeaf = false;
-    		for (int i = 0; i < CHILDNODESIZE; ++i) {
-	    		p->child[i] = (node_t *) malloc (sizeof(node_t));
-		    	p->child[i]->isLeaf = true;
-			    if (p->color == board::piece_type::black)
-				    p->child[i]->color = board::piece_type::white;
-    			else
-	    			p->child[i]->color = board::piece_type::black;
-		    	p->child[i]->count = p->child[i]->rave_count = 0;
-    		}   
-        }
-		for (int i = last; i >= 0; --i) {
-            // store select move
-            if (i < last) {
-                for (int j = 0; j < CHILDNODESIZE; ++j) {
-                    if (selectNode[i]->child[j] == selectNode[i + 1]) {
-                        move[i] = j;
-                        break;
-                    }
-                }
-            }
-            
-            // update by rave
-            for (int j = last - 1; j > i; --j) {
-                if (__builtin_popcount(selectNode[j]->rave_count) == 1)
-                    selectNode[j]->rave_val = (int *) realloc (selectNode[j]->rave_val, (selectNode[j]->rave_count << 1) * sizeof(int));
-    			selectNode[j]->rave_val[selectNode[j]->rave_count] = selectNode[j]->rave_val[selectNode[j]->rave_count - 1] + value;
-			    selectNode[j]->rave_count += 1;
-            }
+	/**
+	 * the child of a node at a position, which is allocated if it is new
+	 * at the node limit, a new child is the shared frontier leaf of its color, which is neither stored nor expanded
+	 */
+	node_t *child (node_t *p, int i) {
+		if (!p->child[i]) {
+			board::piece_type color = p->color == board::piece_type::black ? board::piece_type::white : board::piece_type::black;
+			if (allocated >= node_limit) return &frontier[color == board::black ? 0 : 1];
+			p->child[i] = new_node(color);
+		}
+		return p->child[i];
+	}
 
-            if (selectNode[i]->count == 0)  {
-                selectNode[i]->val = (int *) malloc (1 * sizeof(int));
-    			selectNode[i]->val[selectNode[i]->count] = value;
-                selectNode[i]->rave_val = (int *) malloc (1 * sizeof(int));
-    			selectNode[i]->rave_val[selectNode[i]->rave_count] = value;
-            } else {
-                // simple
-                if (__builtin_popcount(selectNode[i]->count) == 1)
-                    selectNode[i]->val = (int *) realloc (selectNode[i]->val, (selectNode[i]->count << 1) * sizeof(int));
-    			selectNode[i]->val[selectNode[i]->count] = selectNode[i]->val[selectNode[i]->count - 1] + value;
-
-                // rave
-                if (__builtin_popcount(selectNode[i]->rave_count) == 1)
-                    selectNode[i]->rave_val = (int *) realloc (selectNode[i]->rave_val, (selectNode[i]->rave_count << 1) * sizeof(int));
-    			selectNode[i]->rave_val[selectNode[i]->rave_count] = selectNode[i]->rave_val[selectNode[i]->rave_count - 1] + value;
-            }
-			selectNode[i]->count += 1;
-			selectNode[i]->rave_count += 1;
+	/**
+	 * back up the value of a sequence, where the node at depth i is the child move[i - 1] of the node at depth i - 1
+	 * as the RAVE statistics of each node are also updated by the nodes above it, a node at depth i other than
+	 * the leaf is credited i + 1 times
+	 */
+	void updateValue (node_t *selectNode[CHILDNODESIZE], const int move[CHILDNODESIZE], const uint64_t key[CHILDNODESIZE], int value, int last) {
+		for (int i = last; i >= 1; --i) {
+			stats_t& s = *selectNode[i - 1]->stats;
+			int m = move[i - 1];
+			int times = i < last ? i + 1 : 1;
+			s.count[m] += 1;
+			s.val[m] += value;
+			s.spread[m] += pow(s.val[m] / VALUE_SCALE, 2);
+			s.rave_count[m] += times;
+			s.rave_val[m] += times * value;
+			if (helping)
+				table->add(key[i], 1, value);
 		}
 	}
 
     bool isEndBoard (board presentBoard, board::piece_type color) {
         for (int i = 0; i < CHILDNODESIZE; ++i) {
 				board after = presentBoard;
-				if (action::place(i, color).apply(after) == board::legal) {
+				PROFILE_COUNT(probes, 1);
+				if (after.place(board::move(i, color)) == board::legal) {
 					presentBoard.setBoard(i, color);
                     return false;
 				}
@@ -317,16 +919,166 @@ public:
         return true;
     }
 
-	void playOneSequence (node_t *rootNode, board presentBoard) {
-		node_t *selectNode[CHILDNODESIZE] = {NULL};
-		selectNode[0] = rootNode;
+	/**
+	 * a leaf reached by the selection, which may wait in a batch for its evaluation
+	 */
+	struct leaf {
+		node_t *path[CHILDNODESIZE]; // the selected nodes from the root to the leaf
+		int move[CHILDNODESIZE]; // the positions of the selected nodes, i.e., path[i + 1] is the child move[i] of path[i]
+		uint64_t key[CHILDNODESIZE]; // the hashes of the states of the selected nodes, with a shared table
+		int depth; // the index of the leaf in the path
+		board state; // the state at the leaf
+		bool end; // whether the side to move at the leaf has no legal move
+	};
+
+	void descend (node_t *rootNode, const board& presentBoard, leaf& l) {
+		l.path[0] = rootNode;
+		l.key[0] = root_key;
+		l.state = presentBoard;
 		int i = 0;
-		while (!(selectNode[i]->isLeaf)) {
-			selectNode[i + 1] = select(selectNode[i], presentBoard, who);
-			i++;
+		{
+			PROFILE_PHASE(selection);
+			while (!(l.path[i]->isLeaf)) {
+				if (i == 0 && forced != -1) { // a sequence forced through a child of the root
+					l.move[0] = forced;
+					l.state.setBoard(forced, l.path[0]->color);
+					l.state.change_turn();
+				} else {
+					l.move[i] = select(l.path[i], l.state, who);
+				}
+				l.path[i + 1] = child(l.path[i], l.move[i]);
+				if (table)
+					l.key[i + 1] = l.key[i] ^ board::zobrist(l.move[i], l.path[i]->color);
+				i++;
+			}
+		}
+		l.depth = i;
+		{
+			PROFILE_PHASE(expansion);
+			l.end = isEndBoard(l.state, l.path[i]->color);
+		}
+	}
+
+	void complete (leaf& l, int value) {
+		recent.simulations += 1;
+		recent.nodes += l.depth + 1;
+		PROFILE_COUNT(nodes, l.depth + 1);
+		// a leaf is expanded by its visit 'expansion', including this one, while the root is always expanded,
+		// and no leaf is expanded once the tree reaches the node limit
+		bool ripe = !l.depth || l.path[l.depth - 1]->stats->count[l.move[l.depth - 1]] + 1 >= expansion;
+		if (!l.end && l.path[l.depth]->isLeaf && ripe && allocated < node_limit) {
+			PROFILE_PHASE(expansion);
+			expand(l.path[l.depth], l.state, l.key[l.depth]);
+		}
+		{
+			PROFILE_PHASE(backup);
+			updateValue(l.path, l.move, l.key, value, l.depth);
+		}
+	}
+
+	/**
+	 * play up to n sequences whose leaves are evaluated together as a batch, return the number played
+	 *
+	 * each selected leaf holds a virtual loss on its path until the batch is evaluated, so that
+	 * the following selections spread out; a pending leaf selected again is a collision, which is
+	 * dropped while the batch keeps filling, and the batch is closed early after n collisions, when
+	 * the root itself is the pending leaf, or when the flush timeout since the first leaf expires
+	 */
+	int playBatch (node_t *rootNode, const board& presentBoard, int n) {
+		if (n <= 1) {
+			leaf& l = leaves[0];
+			descend(rootNode, presentBoard, l);
+			int value;
+			{
+				PROFILE_PHASE(rollout);
+				value = evaluate(l.state, l.path[l.depth]->color, l.end);
+			}
+			complete(l, value);
+			return 1;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		int k = 0, collisions = 0;
+		while (k < n) {
+			leaf& l = leaves[k];
+			descend(rootNode, presentBoard, l);
+			if (!l.depth && k) { // the root is still a leaf and already pending, so every selection collides
+				recent.collisions += 1;
+				break;
+			}
+			if (l.depth && l.path[l.depth - 1]->stats->pending[l.move[l.depth - 1]]) { // a collision, which is dropped
+				recent.collisions += 1;
+				if (++collisions >= n) break;
+				continue;
+			}
+			for (int j = 0; j < l.depth; ++j)
+				l.path[j]->stats->pending[l.move[j]] += 1;
+			k++;
+			if (flush > 0 && std::chrono::steady_clock::now() - start >= std::chrono::duration<double, std::milli>(flush))
+				break;
 		}
-		int value = simulation(presentBoard, selectNode[i]->color, who);
-		updateValue(selectNode, value, i, isEndBoard(presentBoard, selectNode[i]->color));
+
+		int values[k];
+		{
+			PROFILE_PHASE(rollout);
+			evaluate(leaves.data(), k, values);
+		}
+		for (int i = 0; i < k; ++i) {
+			for (int j = 0; j < leaves[i].depth; ++j)
+				leaves[i].path[j]->stats->pending[leaves[i].move[j]] -= 1;
+			complete(leaves[i], values[i]);
+		}
+		recent.batches += 1;
+		recent.batched += k;
+		return k;
+	}
+
+	/**
+	 * the value of a leaf for this player, in VALUE_SCALE per win
+	 * with eval=nn, a nonterminal leaf is valued by the network, or by a blend of the network and
+	 * a random rollout, where 'blend' is the weight of the network
+	 */
+	int evaluate (const board& presentBoard, board::piece_type color, bool end) {
+		if (!net || end)
+			return simulation(presentBoard, color, who) * VALUE_SCALE;
+		auto start = std::chrono::steady_clock::now();
+		float p = net->value(presentBoard); // of the side to move, i.e., color
+		recent.evaluations += 1;
+		recent.eval_nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		return blended(presentBoard, color, p);
+	}
+
+	/**
+	 * the values of the leaves of a batch, where the network evaluates all nonterminal leaves in one call
+	 */
+	void evaluate (leaf batch[], int n, int values[]) {
+		if (!net) {
+			for (int i = 0; i < n; ++i)
+				values[i] = evaluate(batch[i].state, batch[i].path[batch[i].depth]->color, batch[i].end);
+			return;
+		}
+		const board *states[n];
+		float p[n];
+		int m = 0;
+		for (int i = 0; i < n; ++i)
+			if (!batch[i].end) states[m++] = &batch[i].state;
+		auto start = std::chrono::steady_clock::now();
+		net->values(states, m, p);
+		recent.evaluations += m;
+		recent.eval_nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		for (int i = 0, j = 0; i < n; ++i) {
+			board::piece_type color = batch[i].path[batch[i].depth]->color;
+			values[i] = batch[i].end ? simulation(batch[i].state, color, who) * VALUE_SCALE : blended(batch[i].state, color, p[j++]);
+		}
+	}
+
+	/**
+	 * the value of a nonterminal leaf, where p is the winning probability of the side to move from the network
+	 */
+	int blended (const board& presentBoard, board::piece_type color, float p) {
+		double win = blend < 1 ? (1 - blend) * simulation(presentBoard, color, who) : 0;
+		win += blend * (color == who ? p : 1 - p);
+		return int(win * VALUE_SCALE + 0.5);
 	}
 
 	int simulation (board presentBoard, board::piece_type present_color, board::piece_type true_color) {
@@ -340,8 +1092,10 @@ public:
 
 			for (int i = 0; i < CHILDNODESIZE; ++i) {
 				board after = presentBoard;
-				if (action::place(indexs[i], present_color).apply(after) == board::legal) {
+				PROFILE_COUNT(probes, 1);
+				if (after.place(board::move(indexs[i], present_color)) == board::legal) {
 					presentBoard.setBoard(indexs[i], present_color);
+					PROFILE_COUNT(plies, 1);
 					flag = true;
 					break;
 				}
@@ -361,12 +1115,11 @@ public:
 	}
 
     void free_tree (node_t *root) {
-        if (root->isLeaf)
-            free(root);
-        else {
-            for (int i = 0; i < CHILDNODESIZE; ++i)
+        for (int i = 0; i < CHILDNODESIZE; ++i)
+            if (root->child[i])
                 free_tree(root->child[i]);
-        }
+        free(root->stats);
+        free(root);
     }
 
     void show_board (board::grid stone) {
@@ -379,8 +1132,39 @@ public:
     }
 
 private:
-	std::vector<action::place> space;
+	std::vector<board::move> space;
 	board::piece_type who;
     int simulation_times;
+	search_report recent;
+	size_t ply = 0; // number of moves taken by this player in the current episode
+	std::atomic<bool> halted{false};
+	std::shared_ptr<const network> net; // the leaf evaluator of eval=nn, shared by the players with the same weights
+	double blend = 1; // the weight of the network in the value of a leaf
+	double bias = 0; // the weight of the policy prior of the network in the selection, given by 'prior'
+	int batch = 1; // the maximum number of leaves evaluated together, up to BATCH_LIMIT
+	double flush = 0; // the time limit in milliseconds of filling a batch, or 0 for no limit
+	std::vector<leaf> leaves; // the leaves of the current batch
+	endgame solver; // the endgame analyzer, whose region limit is given by 'endgame', off by default
+	double rave_b = 0.025; // the RAVE bias constant b of beta, given by 'rave'
+	double explore = 1; // the weight of the exploration term of UCB_Tuned, given by 'explore'
+	int expansion = 1; // the number of visits of a leaf before it is expanded, given by 'expand'
+	size_t node_limit = 0; // the maximum number of tree nodes of the current search
+	size_t search_nodes = std::numeric_limits<size_t>::max(); // the node limit of take_action, unlimited unless given by 'nodes'
+	size_t analyze_nodes = 100000; // the node limit of analyze, also given by 'nodes'
+	size_t allocated = 0; // the number of tree nodes of the current search
+	node_t frontier[2]; // the shared leaves of black and white beyond the node limit
+	int helpers = 0; // the number of forked processes helping each search
+	std::vector<int> forcing; // the moves whose visits are forced after the next search, see force()
+	double forcing_share = 0; // the share of the root visits forced to each of the moves
+	int forced = -1; // the child of the root that the current sequences are forced through, or -1
+	std::vector<helper> crew; // the helpers of this player, which is empty in a helper
+	bool helping = false; // whether this is a helper, which only writes to the table
+	std::unique_ptr<shared_table> table; // the table shared with the helpers, whose size in megabytes is given by 'tt'
+	uint64_t root_key = 0; // the key of the root in the table
+	uint64_t searches = 0; // the number of searches, which salts the keys
+#ifdef PROFILE
+	profiler prof;
+	std::unique_ptr<std::ofstream> prof_out;
+#endif
 };
 
@@ -0,0 +1,233 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * arena.h: Utility for running local games between two players
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <sstream>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <random>
+#include <functional>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "statistics.h"
+#include "dataset.h"
+
+class arena {
+public:
+	arena(const std::string& black_args = "", const std::string& white_args = "")
+		: black_args(black_args), white_args(white_args), sink(nullptr), augment(false) {}
+
+public:
+	/**
+	 * export the positions and root visit distributions of the games played by run() to a dataset,
+	 * optionally augmented with the symmetric variants of each position
+	 */
+	void record(dataset* data, bool symmetric = false) {
+		sink = data;
+		augment = symmetric;
+	}
+
+	typedef std::function<void(const board&, agent&)> observer;
+
+	/**
+	 * play a complete game between black and white, from opening to closing the episode
+	 * the observer, if any, is called with the state and the agent after each action is taken
+	 */
+	static void play(episode& game, agent& black, agent& white, const observer& observe = nullptr) {
+		black.open_episode("~:" + white.name());
+		white.open_episode(black.name() + ":~");
+
+		game.open_episode(black.name() + ":" + white.name());
+		while (true) {
+			agent& who = game.take_turns(black, white);
+			action move = who.take_action(game.state());
+			if (observe) observe(game.state(), who);
+			if (game.apply_action(move) != true) break;
+			if (who.check_for_win(game.state())) break;
+		}
+		agent& win = game.last_turns(black, white);
+		game.close_episode(win.name());
+
+		black.close_episode(win.name());
+		white.close_episode(win.name());
+	}
+
+	/**
+	 * run games until the statistics is finished, with the given number of worker threads
+	 * each worker owns a black and white player pair, whose seeds are derived from the worker index
+	 * note that worker 0 uses the original arguments, so a single worker behaves as a plain loop
+	 */
+	void run(statistics& stats, size_t threads = 1) {
+		if (stats.is_finished()) return;
+		threads = std::max<size_t>(threads, 1);
+		std::vector<std::unique_ptr<player>> blacks, whites;
+		for (size_t k = 0; k < threads; k++) { // construct in this thread so that invalid arguments are thrown here
+			blacks.emplace_back(new player("name=black " + seeded(black_args, k) + " role=black"));
+			whites.emplace_back(new player("name=white " + seeded(white_args, k) + " role=white"));
+		}
+
+		auto worker = [&](size_t k) {
+			while (stats.claim_episode()) {
+				episode game;
+				if (sink) {
+					dataset::game samples;
+					play(game, *blacks[k], *whites[k], [&](const board& state, agent& who) {
+						samples.add(state, static_cast<player&>(who).report().visits, augment);
+					});
+					samples.close(game.step() % 2 == 1 ? board::black : board::white);
+					sink->push(std::move(samples));
+				} else {
+					play(game, *blacks[k], *whites[k]);
+				}
+				stats.commit_episode(std::move(game));
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (size_t k = 1; k < threads; k++) pool.emplace_back(worker, k);
+		worker(0);
+		for (std::thread& th : pool) th.join();
+	}
+
+	/**
+	 * run games in forked worker processes, each of which plays a slice of the remaining games
+	 * finished episodes are streamed back through pipes in the statistics record format, one per line,
+	 * and merged into the statistics of this process
+	 * note that the dataset of record() is only supported by run()
+	 * a worker that exits before finishing its slice is restarted for the rest of its games
+	 */
+	void spawn(statistics& stats, size_t procs) {
+		if (stats.is_finished()) return;
+		procs = std::max<size_t>(procs, 1);
+		player::check("name=black " + black_args + " role=black"); // check the arguments before forking
+		player::check("name=white " + white_args + " role=white");
+
+		struct worker {
+			pid_t pid = -1;
+			int fd = -1;
+			size_t games = 0, spawns = 0, failures = 0;
+			std::string buf;
+		};
+		std::vector<worker> workers(procs);
+		for (size_t k = 0; stats.claim_episode(); k = (k + 1) % procs) workers[k].games++;
+		size_t alive = 0; // the number of workers with an open pipe
+		for (size_t k = 0; k < procs; k++) {
+			worker& w = workers[k];
+			if (w.games) fork_worker(w.pid, w.fd, w.games, k + procs * w.spawns++);
+			if (w.fd >= 0) alive++;
+		}
+
+		while (alive) {
+			if (stats.is_finished()) { // stopped early, the remaining games are not needed
+				for (worker& w : workers) if (w.pid > 0) kill(w.pid, SIGTERM);
+				for (worker& w : workers) if (w.pid > 0) close(w.fd), waitpid(w.pid, nullptr, 0);
+				break;
+			}
+
+			std::vector<pollfd> fds;
+			for (worker& w : workers) fds.push_back({ w.fd, POLLIN, 0 });
+			if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) break;
+
+			alive = 0;
+			for (size_t k = 0; k < procs; k++) {
+				worker& w = workers[k];
+				if (w.fd >= 0 && fds[k].revents) {
+					char buf[4096];
+					ssize_t n = read(w.fd, buf, sizeof(buf));
+					if (n > 0) {
+						w.buf.append(buf, n);
+						for (size_t eol; (eol = w.buf.find('\n')) != std::string::npos; w.buf.erase(0, eol + 1)) {
+							episode game;
+							if (std::stringstream(w.buf.substr(0, eol)) >> game) {
+								stats.commit_episode(std::move(game));
+								w.games--, w.failures = 0;
+							}
+						}
+					} else if (n == 0 || errno != EINTR) { // the worker has exited
+						close(w.fd);
+						int status = 0;
+						waitpid(w.pid, &status, 0);
+						w.fd = -1, w.pid = -1, w.buf.clear();
+						if (w.games && w.failures++ < 3) {
+							std::cerr << "worker " << k << " exited with status " << status
+							          << ", restart for " << w.games << " games" << std::endl;
+							fork_worker(w.pid, w.fd, w.games, k + procs * w.spawns++);
+						} else if (w.games) {
+							std::cerr << "worker " << k << " keeps failing, give up " << w.games << " games" << std::endl;
+						}
+					}
+				}
+				if (w.fd >= 0) alive++;
+			}
+		}
+	}
+
+	/**
+	 * derive the player arguments of a worker by overriding its seed
+	 * the base seed is the last "seed=" in the arguments, or the default seed of the engine
+	 */
+	static std::string seeded(const std::string& args, size_t worker) {
+		if (worker == 0) return args;
+		unsigned long long seed = std::default_random_engine::default_seed;
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; ) {
+			if (pair.find("seed=") == 0) seed = std::stoull(pair.substr(5));
+		}
+		return args + " seed=" + std::to_string(seed + worker);
+	}
+
+protected:
+	/**
+	 * fork a worker that plays the given number of games and writes each episode to a pipe
+	 */
+	void fork_worker(pid_t& pid, int& fd, size_t games, size_t index) {
+		int io[2];
+		if (pipe(io) != 0) throw std::runtime_error("pipe failed");
+		std::cout.flush(), std::cerr.flush();
+		pid = fork();
+		if (pid < 0) throw std::runtime_error("fork failed");
+		if (pid == 0) { // in the worker
+			close(io[0]);
+			player black("name=black " + seeded(black_args, index) + " role=black");
+			player white("name=white " + seeded(white_args, index) + " role=white");
+			for (size_t i = 0; i < games; i++) {
+				episode game;
+				play(game, black, white);
+				std::stringstream ss;
+				ss << game << std::endl;
+				std::string rec = ss.str();
+				for (size_t n = 0; n < rec.size(); ) {
+					ssize_t w = write(io[1], rec.data() + n, rec.size() - n);
+					if (w < 0 && errno == EINTR) continue;
+					if (w < 0) _exit(1);
+					n += w;
+				}
+			}
+			close(io[1]);
+			_exit(0);
+		}
+		close(io[1]);
+		fd = io[0];
+	}
+
+private:
+	std::string black_args;
+	std::string white_args;
+	dataset* sink;
+	bool augment;
+};
@@ -0,0 +1,113 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * bench.h: Fixed-position benchmark of the player search
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+
+class benchmark {
+public:
+	/**
+	 * the player arguments are appended to "search=MCTS simulation=1000 seed=1",
+	 * so that the budget and the seed can be overridden
+	 */
+	benchmark(const std::string& args = "") : args("search=MCTS simulation=1000 seed=1 " + args), positions(suite()) {}
+
+public:
+	/**
+	 * load the positions from a stream, one position per line as a sequence of GTP moves
+	 * an empty line is the initial position, and lines beginning with '#' are ignored
+	 */
+	void load(std::istream& in) {
+		positions.clear();
+		for (std::string line; std::getline(in, line); ) {
+			if (line.size() && line.back() == '\r') line.pop_back();
+			if (line.size() && line[0] == '#') continue;
+			positions.push_back(line);
+		}
+	}
+
+	/**
+	 * run the search on each position with a fresh player, and print one JSON object per line
+	 *
+	 * the format of a position is
+	 * {"position":2,"ply":20,"color":"b","move":"C5","msec":118.3,"simulations":1000,"nodes":5373,"sps":8453,"nps":45417}
+	 *
+	 * the last line is the summary of the suite, whose 'moves' lists the chosen moves in order
+	 */
+	void run(std::ostream& out) const {
+		typedef std::chrono::steady_clock clock;
+		double total_ms = 0;
+		size_t total_sims = 0, total_nodes = 0;
+		std::string moves;
+		for (size_t k = 0; k < positions.size(); k++) {
+			board state;
+			size_t ply = 0;
+			std::stringstream ss(positions[k]);
+			for (std::string move; ss >> move; ply++) {
+				if (state.place(board::point(move)) != board::legal)
+					throw std::invalid_argument("illegal move " + move + " in position " + std::to_string(k));
+			}
+			std::string role = state.info().who_take_turns == board::black ? "black" : "white";
+			player who("name=bench " + args + " role=" + role);
+
+			auto start = clock::now();
+			action::place move = who.take_action(state);
+			double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+			const player::search_report& rep = who.report();
+			std::string pos = move.action::type() == action::place::type ? std::string(move.position()) : "PASS";
+			out << "{\"position\":" << k << ",\"ply\":" << ply << ",\"color\":\"" << role[0] << "\""
+			    << ",\"move\":\"" << pos << "\",\"msec\":" << ms
+			    << ",\"simulations\":" << rep.simulations << ",\"nodes\":" << rep.nodes
+			    << ",\"sps\":" << (rep.simulations * 1000.0 / ms) << ",\"nps\":" << (rep.nodes * 1000.0 / ms);
+			if (rep.solved) out << ",\"solved\":true";
+			if (rep.shared) out << ",\"shared\":" << rep.shared;
+			if (rep.batches) out << ",\"batches\":" << rep.batches << ",\"batched\":" << rep.batched << ",\"collisions\":" << rep.collisions;
+			if (rep.evaluations) out << ",\"evals\":" << rep.evaluations << ",\"eval_ns\":" << (rep.eval_nanos * 1.0 / rep.evaluations);
+			out << "}" << std::endl;
+			total_ms += ms;
+			total_sims += rep.simulations;
+			total_nodes += rep.nodes;
+			moves += (k ? " " : "") + pos;
+		}
+		out << "{\"positions\":" << positions.size() << ",\"msec\":" << total_ms
+		    << ",\"msec_per_move\":" << (total_ms / positions.size())
+		    << ",\"simulations\":" << total_sims << ",\"nodes\":" << total_nodes
+		    << ",\"sps\":" << (total_sims * 1000.0 / total_ms) << ",\"nps\":" << (total_nodes * 1000.0 / total_ms)
+		    << ",\"moves\":\"" << moves << "\"}" << std::endl;
+	}
+
+	/**
+	 * the built-in suite, from the opening to the late endgame of random games
+	 * note that perft.h keeps the expected leaf counts of these positions
+	 */
+	static std::vector<std::string> suite() {
+		return {
+			"",
+			"F8 G7 B2 A7 C6 H8 A8",
+			"F3 C2 F8 C8 F6 B6 C9 D5 J5 C6 D4 J8 D1 D7 A8 A4 B8 H9 B9 H2",
+			"F6 C2 A7 A9 A5 G3 G2 B1 B7 C6 H7 J3 B9 A4 D5 G7 G1 E9 F4 F1 H8 D6 J8 J6 D3 G9 D2 H6 F8 C8 H9",
+			"J7 A6 F5 D2 G4 B4 H9 D4 C7 J6 F6 E1 C3 H7 F7 A1 F4 E5 J9 D7 E4 D9 J3 F8 B6 A2 D3 A5 F3 A7 B3 H1 "
+			"A8 J5 D6 B9 J4 A4 C8 H6 C6 A3 G6 H2",
+			"J6 H3 H1 G8 G9 B6 G4 F3 H8 F5 D1 J7 H9 D2 G6 D5 A9 D3 J8 H4 A8 A7 E1 J5 A3 J4 G7 F1 C6 F8 J3 G1 "
+			"C7 A1 D8 B9 F9 J1 B1 B7 F6 C2 B3 D6 F4 A6 C3 C4 E4 C9 B4 D9",
+		};
+	}
+
+private:
+	std::string args;
+	std::vector<std::string> positions;
+};
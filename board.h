@@ -15,6 +15,9 @@
 #include <algorithm>
 #include <utility>
 #include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include "counter.h"
 
 /**
  * definition for the 9x9 board
@@ -54,6 +57,20 @@ public:
 	};
 	typedef uint64_t score;
 	typedef int reward;
+
+	/**
+	 * a trivially copyable placing move in 16 bits, used on the hot path instead of the polymorphic action
+	 * the low byte is the position in 1-d array style (0xff for none), and the high byte is the color
+	 */
+	struct move {
+		uint16_t code;
+		move() = default;
+		constexpr move(int i, unsigned who) : code(uint16_t(((who & 0xff) << 8) | (i & 0xff))) {}
+		int position() const { return (code & 0xff) != 0xff ? (code & 0xff) : -1; }
+		unsigned color() const { return code >> 8; }
+		bool operator ==(const move& m) const { return code == m.code; }
+		bool operator !=(const move& m) const { return code != m.code; }
+	};
     void change_turn () {
         attr.who_take_turns = attr.who_take_turns == board::piece_type::black ? attr.who_take_turns = board::piece_type::white : attr.who_take_turns = board::piece_type::black;
     }
@@ -61,7 +78,11 @@ public:
 public:
 	board() : stone(initial()), attr({piece_type::black}) {}
 	board(const grid& b, const data& d) : stone(b), attr(d) {}
+#ifdef COUNTERS
+	board(const board& b) : stone(b.stone), attr(b.attr) { COUNT_EVENT(board_copy); }
+#else
 	board(const board& b) = default;
+#endif
 	board& operator =(const board& b) = default;
 
 	struct point {
@@ -100,6 +121,39 @@ public:
 	bool operator <=(const board& b) const { return !(b < *this); }
 	bool operator >=(const board& b) const { return !(*this < b); }
 
+public:
+	/**
+	 * the Zobrist key of a cell state at a position in 1-d array style, generated by splitmix64
+	 */
+	static uint64_t zobrist(int i, unsigned cell) {
+		struct table {
+			uint64_t key[size_x * size_y * 4];
+			table() {
+				uint64_t x = 0x4e6f476f;
+				for (uint64_t& k : key) {
+					uint64_t z = (x += 0x9e3779b97f4a7c15ull);
+					z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+					z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+					k = z ^ (z >> 31);
+				}
+			}
+		};
+		static const table t;
+		return t.key[i * 4 + (cell & 3)];
+	}
+
+	/**
+	 * the Zobrist hash of the stones, where the side to move is implied by the number of stones
+	 */
+	uint64_t hash() const {
+		uint64_t h = 0;
+		for (int i = 0; i < size_x * size_y; i++) {
+			unsigned cell = operator ()(i);
+			if (cell == black || cell == white) h ^= zobrist(i, cell);
+		}
+		return h;
+	}
+
 public:
 	enum nogo_move_result {
 		legal = reward(0),
@@ -139,6 +193,9 @@ public:
 	reward place(const point& p, unsigned who = piece_type::unknown) {
 		return place(p.x, p.y, who);
 	}
+	reward place(const move& m) {
+		return place(point(m.position()), m.color());
+	}
 
 	/**
 	 * calculate the liberty of the block of piece at [x][y]
@@ -146,11 +203,12 @@ public:
 	 */
 	int check_liberty(int x, int y, unsigned who) const {
 		grid test = stone;
+		COUNT_EVENT(grid_copy);
 		if (test[x][y] != who) return -1;
 
 		int liberty = 0;
 		std::list<point> check;
-		for (check.emplace_back(x, y); check.size(); check.pop_front()) {
+		for (check.emplace_back(x, y), COUNT_EVENT(list_node); check.size(); check.pop_front()) {
 			int x = check.front().x, y = check.front().y;
 			test[x][y] = piece_type::unknown; // prevent recalculate
 
@@ -158,19 +216,19 @@ public:
 
 			cell near_l = x > p_min.x ? test[x - 1][y] : -1u; // left
 			if (near_l == piece_type::empty) liberty++;
-			else if (near_l == who) check.emplace_back(x - 1, y);
+			else if (near_l == who) check.emplace_back(x - 1, y), COUNT_EVENT(list_node);
 
 			cell near_r = x < p_max.x ? test[x + 1][y] : -1u; // right
 			if (near_r == piece_type::empty) liberty++;
-			else if (near_r == who) check.emplace_back(x + 1, y);
+			else if (near_r == who) check.emplace_back(x + 1, y), COUNT_EVENT(list_node);
 
 			cell near_d = y > p_min.y ? test[x][y - 1] : -1u; // down
 			if (near_d == piece_type::empty) liberty++;
-			else if (near_d == who) check.emplace_back(x, y - 1);
+			else if (near_d == who) check.emplace_back(x, y - 1), COUNT_EVENT(list_node);
 
 			cell near_u = y < p_max.y ? test[x][y + 1] : -1u; // up
 			if (near_u == piece_type::empty) liberty++;
-			else if (near_u == who) check.emplace_back(x, y + 1);
+			else if (near_u == who) check.emplace_back(x, y + 1), COUNT_EVENT(list_node);
 		}
 		return liberty;
 	}
@@ -305,3 +363,5 @@ private:
 	grid stone;
 	data attr;
 };
+
+static_assert(std::is_trivially_copyable<board::move>::value && sizeof(board::move) == 2, "board::move should be a 16-bit POD");
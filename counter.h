@@ -0,0 +1,117 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * counter.h: Build-time counters of hidden work on the hot path
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+
+#ifdef COUNTERS
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+/**
+ * event counters, enabled by compiling with -DCOUNTERS
+ * each thread counts in a block of its own, so that the hot paths do not share cache lines, and the blocks
+ * are merged when the totals are read; the counters are not collected from forked workers
+ */
+struct counters {
+	enum event {
+		board_copy, // copies of a board, e.g., the trial board in board::place
+		grid_copy, // copies of the grid in board::check_liberty
+		list_node, // std::list node allocations in board::check_liberty
+		node_alloc, // malloc of search tree nodes
+		stats_alloc, // aligned malloc of the child statistics of search tree nodes
+		reinterpret, // placement-new in action::reinterpret
+		events
+	};
+
+	/**
+	 * the counts of all events, e.g., of a thread so far, or of the work between two samples
+	 */
+	struct sample {
+		uint64_t count[events];
+		sample() : count() {}
+		sample operator -(const sample& s) const {
+			sample d;
+			for (unsigned e = 0; e < events; e++) d.count[e] = count[e] - s.count[e];
+			return d;
+		}
+		sample& operator +=(const sample& s) {
+			for (unsigned e = 0; e < events; e++) count[e] += s.count[e];
+			return *this;
+		}
+	};
+
+	static void add(unsigned e) {
+		std::atomic<uint64_t>& c = mine().count[e]; // only written by this thread, so no locked instruction is needed
+		c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	/**
+	 * the counts of the calling thread so far
+	 */
+	static sample local() {
+		sample s;
+		const block& b = mine();
+		for (unsigned e = 0; e < events; e++) s.count[e] = b.count[e].load(std::memory_order_relaxed);
+		return s;
+	}
+
+	/**
+	 * the total count of an event over all threads, including the exited ones
+	 */
+	static uint64_t at(unsigned e) {
+		registry& r = blocks();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		uint64_t n = r.retired.count[e];
+		for (const block* b : r.live) n += b->count[e].load(std::memory_order_relaxed);
+		return n;
+	}
+
+	static const char* name(unsigned e) {
+		static const char* label[] = { "board_copy", "grid_copy", "list_node", "node_alloc", "stats_alloc", "reinterpret" };
+		return label[e];
+	}
+
+private:
+	struct block;
+	struct registry {
+		std::mutex mutex;
+		std::vector<const block*> live;
+		sample retired; // the counts of the exited threads
+	};
+	struct alignas(64) block {
+		std::atomic<uint64_t> count[events];
+		block() {
+			for (unsigned e = 0; e < events; e++) count[e].store(0, std::memory_order_relaxed);
+			registry& r = blocks();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			r.live.push_back(this);
+		}
+		~block() {
+			registry& r = blocks();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			for (unsigned e = 0; e < events; e++) r.retired.count[e] += count[e].load(std::memory_order_relaxed);
+			r.live.erase(std::find(r.live.begin(), r.live.end(), this));
+		}
+	};
+	static registry& blocks() {
+		static registry r;
+		return r;
+	}
+	static block& mine() {
+		static thread_local block b;
+		return b;
+	}
+};
+#define COUNT_EVENT(e) (counters::add(counters::e))
+#else
+#define COUNT_EVENT(e) ((void) 0)
+#endif
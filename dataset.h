@@ -0,0 +1,201 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * dataset.h: Training data export from self-play games
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <stdexcept>
+#include "board.h"
+#include "agent.h"
+
+/**
+ * the layout of a dataset file (native byte order) is a 64-byte header followed by fixed-stride samples,
+ * so that it can be memory-mapped directly as an array of samples after the header
+ *
+ * each sample describes a position and the search result of the side to move, where
+ *  'cells' is the board in 1-d array style, with 0 = empty, 1 = black, 2 = white, 3 = hollow
+ *  'color' is the side to move, 1 = black, 2 = white
+ *  'result' is +1 if the side to move won the game, or -1 if not
+ *  'policy' is the visit distribution of the children of the root, in 1-d array style
+ */
+class dataset {
+public:
+	enum magic : uint64_t { file_magic = 0x314e52544f474f4eull }; // "NOGOTRN1"
+
+	struct header {
+		uint64_t magic;
+		uint32_t stride; // sizeof(sample)
+		uint32_t cells; // board::size_x * board::size_y
+		uint64_t samples; // number of samples, updated when the writer is closed
+		uint8_t reserved[40];
+	};
+
+	struct sample {
+		uint8_t cells[board::size_x * board::size_y];
+		uint8_t color;
+		int8_t result;
+		uint8_t reserved[5];
+		float policy[board::size_x * board::size_y];
+	};
+
+	/**
+	 * the samples of a game, completed with the result when the game ends
+	 */
+	class game {
+	public:
+		/**
+		 * add a position with the root visit counts of its search, optionally with its 7 symmetric variants
+		 * positions without any visit, e.g., from a random player, are skipped
+		 */
+		void add(const board& state, const int visits[], bool augment = false) {
+			int sum = 0;
+			for (int i = 0; i < board::size_x * board::size_y; i++) sum += visits[i];
+			if (sum == 0) return;
+			for (int s = 0; s < (augment ? 8 : 1); s++) {
+				const std::array<int, board::size_x * board::size_y>& from = symmetry(s);
+				sample smp = {};
+				for (int i = 0; i < board::size_x * board::size_y; i++) {
+					smp.cells[i] = state(from[i]);
+					smp.policy[i] = visits[from[i]] * 1.0f / sum;
+				}
+				smp.color = state.info().who_take_turns;
+				samples.push_back(smp);
+			}
+		}
+
+		/**
+		 * fill the result of each sample with the winner of the game
+		 */
+		void close(unsigned winner) {
+			for (sample& smp : samples) smp.result = smp.color == winner ? +1 : -1;
+		}
+
+		std::vector<sample> samples;
+	};
+
+public:
+	dataset(const std::string& path, size_t pending_limit = 64 << 20)
+		: file(std::fopen(path.c_str(), "wb")), written(0), pending(0), limit(pending_limit), closing(false) {
+		if (!file) throw std::runtime_error("cannot open " + path);
+		header h = {};
+		h.magic = file_magic;
+		h.stride = sizeof(sample);
+		h.cells = board::size_x * board::size_y;
+		std::fwrite(&h, sizeof(h), 1, file);
+		writer = std::thread(&dataset::flush, this);
+	}
+	dataset(const dataset&) = delete;
+	dataset& operator =(const dataset&) = delete;
+	~dataset() { close(); }
+
+public:
+	/**
+	 * queue the samples of a finished game, which are written by a background thread
+	 * the caller only waits if the pending samples exceed the limit
+	 */
+	void push(game&& g) {
+		if (g.samples.empty()) return;
+		std::unique_lock<std::mutex> lock(mutex);
+		full.wait(lock, [&]() { return pending < limit; });
+		pending += g.samples.size() * sizeof(sample);
+		queue.push_back(std::move(g.samples));
+		ready.notify_one();
+	}
+
+	/**
+	 * write the remaining samples, update the header, and close the file
+	 */
+	void close() {
+		if (!file) return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closing = true;
+			ready.notify_one();
+		}
+		writer.join();
+		uint64_t samples = written;
+		std::fseek(file, offsetof(header, samples), SEEK_SET);
+		std::fwrite(&samples, sizeof(samples), 1, file);
+		std::fclose(file);
+		file = nullptr;
+	}
+
+	/**
+	 * read all samples of a dataset file, including those of a file whose writer was not closed
+	 */
+	static std::vector<sample> read(const std::string& path) {
+		std::FILE* in = std::fopen(path.c_str(), "rb");
+		if (!in) throw std::runtime_error("cannot open " + path);
+		header h = {};
+		bool ok = std::fread(&h, sizeof(h), 1, in) == 1 && h.magic == file_magic
+		          && h.stride == sizeof(sample) && h.cells == board::size_x * board::size_y;
+		std::vector<sample> samples;
+		for (sample smp; ok && std::fread(&smp, sizeof(smp), 1, in) == 1; ) samples.push_back(smp);
+		std::fclose(in);
+		if (!ok) throw std::runtime_error("not a dataset file: " + path);
+		return samples;
+	}
+
+	/**
+	 * the mapping of a symmetry from the transformed positions to the original positions,
+	 * where s = 0 is the identity, s = 1 ~ 3 are rotations, and s = 4 ~ 7 are reflections with rotations
+	 */
+	static const std::array<int, board::size_x * board::size_y>& symmetry(int s) {
+		static std::array<std::array<int, board::size_x * board::size_y>, 8> map = []() {
+			std::array<std::array<int, board::size_x * board::size_y>, 8> map;
+			board::grid index;
+			for (int i = 0; i < board::size_x * board::size_y; i++) index[i / board::size_y][i % board::size_y] = i;
+			for (int s = 0; s < 8; s++) {
+				board b(index, board::data());
+				if (s >= 4) b.reflect_horizontal();
+				b.rotate(s % 4);
+				for (int i = 0; i < board::size_x * board::size_y; i++) map[s][i] = b(i);
+			}
+			return map;
+		}();
+		return map[s];
+	}
+
+protected:
+	void flush() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			ready.wait(lock, [&]() { return queue.size() || closing; });
+			if (queue.empty()) break;
+			std::vector<sample> samples = std::move(queue.front());
+			queue.pop_front();
+			lock.unlock();
+			std::fwrite(samples.data(), sizeof(sample), samples.size(), file);
+			lock.lock();
+			written += samples.size();
+			pending -= samples.size() * sizeof(sample);
+			full.notify_all();
+		}
+	}
+
+private:
+	std::FILE* file;
+	uint64_t written;
+	size_t pending;
+	size_t limit;
+	bool closing;
+	std::deque<std::vector<sample>> queue;
+	std::mutex mutex;
+	std::condition_variable ready, full;
+	std::thread writer;
+};
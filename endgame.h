@@ -0,0 +1,213 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * endgame.h: Region decomposition and exact solving of NoGo endgames
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include "board.h"
+
+/**
+ * an endgame analyzer, which splits the board into independent regions and solves them exactly
+ *
+ * a region is a set of empty points joined by adjacency, or by being liberties of the same chain;
+ * since a move only changes the liberties of the chains next to it, which all lie in its region,
+ * the game is the sum of its regions, where black is Left and white is Right in the terms of
+ * combinatorial game theory, and the player without a legal move loses
+ *
+ * each region is solved by exhaustive search, and is solved when its value is a number, i.e., the
+ * number of free moves that black is ahead in the region; the values are memoized by the Zobrist
+ * hash of the region points and the stones of the chains next to them, so a region is only solved
+ * once, even when it appears again in later positions
+ *
+ * when every region is a number, the sum decides the game, and the best move is the one that
+ * loses the least value for its side; otherwise, e.g., for a hot region, the analyzer gives up
+ */
+class endgame {
+public:
+	/**
+	 * limit is the maximum number of empty points of a region to be solved, and 0 disables the analyzer
+	 * the memo holds up to 64 entries per possible position of a region, i.e., 64 << limit, at most 1M
+	 */
+	endgame(size_t limit = 0) : limit(limit), capacity(std::min<size_t>(size_t(64) << std::min<size_t>(limit, 14), 1 << 20)) {}
+
+	struct region {
+		std::vector<int> points; // the empty points in 1-d array style
+		uint64_t key; // the hash of the points and the stones of the chains next to them
+	};
+
+public:
+	/**
+	 * the best move of the side to move if every region of the state is solved, or a move of no position if not
+	 * the value of the state, i.e., the sum of the values of the regions, is stored in 'total'
+	 */
+	board::move choose(const board& state, double* total = nullptr) {
+		if (limit == 0) return board::move(-1, board::empty);
+		std::vector<region> regions = decompose(state);
+		for (const region& r : regions)
+			if (r.points.size() > limit) return board::move(-1, board::empty);
+
+		std::vector<double> values;
+		double sum = 0;
+		for (const region& r : regions) {
+			board copy = state;
+			values.push_back(solve(copy, r.points, r.key));
+			if (std::isnan(values.back())) return board::move(-1, board::empty);
+			sum += values.back();
+		}
+		if (total) *total = sum;
+
+		unsigned who = state.info().who_take_turns;
+		board::move best(-1, board::empty);
+		double delta = 0;
+		for (size_t k = 0; k < regions.size(); k++) {
+			for (int p : regions[k].points) {
+				board after = state;
+				if (after.place(board::move(p, who)) != board::legal) continue;
+				uint64_t key = regions[k].key ^ board::zobrist(p, board::empty) ^ board::zobrist(p, who);
+				double d = solve(after, regions[k].points, key) - values[k];
+				if (who == board::white) d = -d;
+				if (best.position() == -1 || d > delta) {
+					best = board::move(p, who);
+					delta = d;
+				}
+			}
+		}
+		return best;
+	}
+
+	/**
+	 * split the empty points of the state into independent regions
+	 */
+	static std::vector<region> decompose(const board& state) {
+		const int n = board::size_x * board::size_y;
+		// nodes [0, n) are the points, and nodes [n, 2n) are the chains, named by their first stones
+		int parent[2 * n];
+		for (int i = 0; i < 2 * n; i++) parent[i] = i;
+		auto find = [&](int i) { while (parent[i] != i) i = parent[i] = parent[parent[i]]; return i; };
+		auto unite = [&](int a, int b) { parent[find(a)] = find(b); };
+
+		int chain[n];
+		for (int i = 0; i < n; i++) chain[i] = -1;
+		for (int i = 0; i < n; i++) { // label the chains by flood fill
+			if (chain[i] != -1 || (state(i) != board::black && state(i) != board::white)) continue;
+			std::vector<int> stack = { i };
+			chain[i] = i;
+			while (stack.size()) {
+				int p = stack.back();
+				stack.pop_back();
+				for (int q : neighbors(p)) {
+					if (chain[q] == -1 && state(q) == state(i)) {
+						chain[q] = i;
+						stack.push_back(q);
+					}
+				}
+			}
+		}
+
+		for (int i = 0; i < n; i++) {
+			if (state(i) != board::empty) continue;
+			for (int q : neighbors(i)) {
+				if (state(q) == board::empty) unite(i, q);
+				else if (chain[q] != -1) unite(i, n + chain[q]);
+			}
+		}
+
+		std::vector<region> regions;
+		int index[2 * n];
+		for (int i = 0; i < 2 * n; i++) index[i] = -1;
+		for (int i = 0; i < n; i++) {
+			if (state(i) != board::empty) continue;
+			int root = find(i);
+			if (index[root] == -1) {
+				index[root] = regions.size();
+				regions.push_back({ {}, 0 });
+			}
+			regions[index[root]].points.push_back(i);
+			regions[index[root]].key ^= board::zobrist(i, board::empty);
+		}
+		for (int i = 0; i < n; i++) { // the stones of the chains next to each region
+			if (chain[i] == -1) continue;
+			int root = find(n + chain[i]);
+			if (index[root] != -1) regions[index[root]].key ^= board::zobrist(i, state(i));
+		}
+		return regions;
+	}
+
+	size_t size() const { return memo.size(); }
+
+protected:
+	/**
+	 * the value of a region in the state, where key is the hash of the region, or NaN if it is not a number
+	 */
+	double solve(board& state, const std::vector<int>& points, uint64_t key) {
+		auto it = memo.find(key);
+		if (it != memo.end()) return it->second;
+
+		const double inf = std::numeric_limits<double>::infinity();
+		double left = -inf, right = inf; // the best options of black and white
+		bool number = true;
+		board::data turn = state.info();
+		for (size_t k = 0; k < points.size() && number; k++) {
+			int p = points[k];
+			if (state(p) != board::empty) continue;
+			for (unsigned who : { board::black, board::white }) {
+				board after = state;
+				after.info({ static_cast<board::piece_type>(who) });
+				if (after.place(board::move(p, who)) != board::legal) continue;
+				double v = solve(after, points, key ^ board::zobrist(p, board::empty) ^ board::zobrist(p, who));
+				if (std::isnan(v)) {
+					number = false;
+					break;
+				}
+				if (who == board::black) left = std::max(left, v);
+				else right = std::min(right, v);
+			}
+		}
+		state.info(turn);
+
+		double value = number && left < right ? simplest(left, right) : std::numeric_limits<double>::quiet_NaN();
+		if (memo.size() >= capacity) memo.clear();
+		memo[key] = value;
+		return value;
+	}
+
+	/**
+	 * the simplest number strictly between left and right, which may be infinite
+	 */
+	static double simplest(double left, double right) {
+		if (left < 0 && right > 0) return 0;
+		if (right <= 0) return -simplest(-right, -left);
+		// now 0 <= left < right, try the integers, then the halves, the quarters, and so on
+		double n = std::floor(left) + 1;
+		if (n < right) return n;
+		for (double unit = 0.5; ; unit /= 2) {
+			double x = (std::floor(left / unit) + 1) * unit;
+			if (x < right) return x;
+		}
+	}
+
+	static std::vector<int> neighbors(int i) {
+		std::vector<int> list;
+		int x = i / board::size_y, y = i % board::size_y;
+		if (x > 0) list.push_back(i - board::size_y);
+		if (x < board::size_x - 1) list.push_back(i + board::size_y);
+		if (y > 0) list.push_back(i - 1);
+		if (y < board::size_y - 1) list.push_back(i + 1);
+		return list;
+	}
+
+private:
+	size_t limit;
+	size_t capacity; // the memo is cleared when it is full
+	std::unordered_map<uint64_t, double> memo;
+};
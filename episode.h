@@ -21,7 +21,7 @@
 
 class episode {
 public:
-	episode() : ep_state(initial_state()), ep_score(0), ep_time(0) {
+	episode() : ep_state(initial_state()), ep_score(0), ep_time(0), ep_spent{0, 0} {
 		ep_moves.reserve(board::size_x * board::size_y);
 	}
 
@@ -37,14 +37,26 @@ public:
 		ep_close = { tag, millisec() };
 	}
 	bool apply_action(action move) {
-		board::reward reward = move.apply(state());
+		return apply_action(action::place(move).move());
+	}
+	bool apply_action(board::move move) {
+		board::reward reward = state().place(move);
 		if (reward != board::legal) return false;
 		ep_moves.emplace_back(move, reward, millisec() - ep_time);
+		ep_spent[(ep_moves.size() - 1) % 2] += ep_moves.back().time;
+#ifdef COUNTERS
+		ep_work.push_back(ep_marked ? counters::local() - ep_mark : counters::sample());
+		ep_marked = false;
+#endif
 		ep_score += reward;
 		return true;
 	}
 	agent& take_turns(agent& black, agent& white) {
 		ep_time = millisec();
+#ifdef COUNTERS
+		ep_mark = counters::local();
+		ep_marked = true;
+#endif
 		return (step() % 2) ? white : black;
 	}
 	agent& last_turns(agent& black, agent& white) {
@@ -69,11 +81,11 @@ public:
 		switch (who) {
 		case board::black:
 		case action::black::type:
-			for (size_t i = 0; i < ep_moves.size(); i += 2) time += ep_moves[i].time;
+			time = ep_spent[0];
 			break;
 		case board::white:
 		case action::white::type:
-			for (size_t i = 1; i < ep_moves.size(); i += 2) time += ep_moves[i].time;
+			time = ep_spent[1];
 			break;
 		case action::place::type:
 		default:
@@ -102,6 +114,36 @@ public:
 		return res;
 	}
 
+#ifdef COUNTERS
+	/**
+	 * the hot-path events of each move, counted on the thread that takes the turn, from take_turns to apply_action;
+	 * a move applied without take_turns, e.g., of a remote player, or a loaded move, counts nothing
+	 */
+	const std::vector<counters::sample>& work() const { return ep_work; }
+#endif
+
+	/**
+	 * the thinking time of each move, in milliseconds
+	 */
+	std::vector<time_t> times(unsigned who = -1u) const {
+		std::vector<time_t> res;
+		switch (who) {
+		case board::black:
+		case action::black::type:
+			for (size_t i = 0; i < ep_moves.size(); i += 2) res.push_back(ep_moves[i].time);
+			break;
+		case board::white:
+		case action::white::type:
+			for (size_t i = 1; i < ep_moves.size(); i += 2) res.push_back(ep_moves[i].time);
+			break;
+		case action::place::type:
+		default:
+			for (const move& mv : ep_moves) res.push_back(mv.time);
+			break;
+		}
+		return res;
+	}
+
 public:
 
 	friend std::ostream& operator <<(std::ostream& out, const episode& ep) {
@@ -140,6 +182,7 @@ public:
 				ss >> ep.ep_moves.back();
 			}
 			ep.ep_score = 0;
+			ep.account();
 		} else {
 			in.setstate(std::ios::failbit);
 		}
@@ -149,19 +192,22 @@ public:
 protected:
 
 	struct move {
-		action code;
+		board::move code;
 		board::reward reward;
 		time_t time;
-		move(action code = {}, board::reward reward = 0, time_t time = 0) : code(code), reward(reward), time(time) {}
+		move(board::move code = board::move(-1, board::empty), board::reward reward = 0, time_t time = 0)
+			: code(code), reward(reward), time(time) {}
 
-		operator action() const { return code; }
+		operator action() const { return action::place(code); }
 		friend std::ostream& operator <<(std::ostream& out, const move& m) {
-			out << m.code;
+			out << action::place(m.code);
 			if (m.time) out << "C[" << std::dec << m.time << "]";
 			return out;
 		}
 		friend std::istream& operator >>(std::istream& in, move& m) {
-			in >> m.code;
+			action code;
+			in >> code;
+			m.code = action::place(code).move();
 			m.reward = 0;
 			m.time = 0;
 			if (in.peek() == 'C') {
@@ -194,12 +240,28 @@ protected:
 		return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
 	}
 
+	/**
+	 * recalculate the total thinking time of each side from the moves
+	 */
+	void account() {
+		ep_spent[0] = ep_spent[1] = 0;
+		for (size_t i = 0; i < ep_moves.size(); i++) ep_spent[i % 2] += ep_moves[i].time;
+	}
+
+	friend class record; // binary format
+
 private:
 	board ep_state;
 	board::score ep_score;
 	std::vector<move> ep_moves;
 	time_t ep_time;
+	time_t ep_spent[2]; // total thinking time of black and white
 
 	meta ep_open;
 	meta ep_close;
+#ifdef COUNTERS
+	std::vector<counters::sample> ep_work; // the events of each move
+	counters::sample ep_mark; // the events of the thread at take_turns
+	bool ep_marked = false;
+#endif
 };
@@ -0,0 +1,194 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * microbench.cpp: Microbenchmarks of the board, action, episode and statistics primitives
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <cstdio>
+#include <unistd.h>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "statistics.h"
+#include "bench.h"
+#include "network.h"
+
+static volatile long sink; // prevent the measured work from being optimized out
+
+/**
+ * run 'f' for 'ops' times in each of 'samples' samples, and print the ns/op as
+ * mean, standard deviation, minimum and maximum of the samples
+ */
+template<typename F>
+static void measure(const std::string& name, size_t ops, F f, size_t samples = 15) {
+	typedef std::chrono::steady_clock clock;
+	for (size_t i = 0; i < ops / 10 + 1; i++) f(); // warm up
+	std::vector<double> ns;
+	for (size_t s = 0; s < samples; s++) {
+		auto start = clock::now();
+		for (size_t i = 0; i < ops; i++) f();
+		ns.push_back(std::chrono::duration<double, std::nano>(clock::now() - start).count() / ops);
+	}
+	double mean = 0, var = 0;
+	for (double v : ns) mean += v;
+	mean /= ns.size();
+	for (double v : ns) var += (v - mean) * (v - mean);
+	var /= (ns.size() - 1);
+	std::cout << std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+	          << std::setw(12) << mean << " ns/op +- " << std::setw(8) << std::sqrt(var)
+	          << "  [" << *std::min_element(ns.begin(), ns.end())
+	          << ", " << *std::max_element(ns.begin(), ns.end()) << "]" << std::endl;
+}
+
+/**
+ * replay a sequence of GTP moves from the initial state
+ */
+static board replay(const std::string& moves) {
+	board state;
+	std::stringstream ss(moves);
+	for (std::string move; ss >> move; state.place(board::point(move)));
+	return state;
+}
+
+/**
+ * a board with a single black chain of the given size along the outer ring, and no other stone
+ */
+static board chain(size_t size) {
+	std::vector<board::point> ring;
+	for (int x = 0; x < 8; x++) ring.emplace_back(x, 0);
+	for (int y = 0; y < 8; y++) ring.emplace_back(8, y);
+	for (int x = 8; x > 0; x--) ring.emplace_back(x, 8);
+	for (int y = 8; y > 0; y--) ring.emplace_back(0, y);
+	board state;
+	for (size_t i = 0; i < size && i < ring.size(); i++) state[ring[i].x][ring[i].y] = board::black;
+	return state;
+}
+
+int main(int argc, const char* argv[]) {
+	std::string game = benchmark::suite().back();
+	board mid = replay(benchmark::suite()[2]);
+
+	// find a legal, an occupied and a suicide point for the side to move
+	unsigned who = mid.info().who_take_turns;
+	board::point legal, occupied, suicide;
+	for (int i = 0; i < board::size_x * board::size_y; i++) {
+		board test = mid;
+		board::reward r = test.place(board::point(i), who);
+		if (r == board::legal && legal.i == -1) legal = board::point(i);
+		if (r == board::illegal_not_empty && occupied.i == -1) occupied = board::point(i);
+		if ((r == board::illegal_suicide || r == board::illegal_take) && suicide.i == -1) suicide = board::point(i);
+	}
+
+	std::cout << "board::place" << std::endl;
+	measure("copy (baseline)", 1000000, [&]() { board b = mid; sink += b[0][0]; });
+	measure("copy + place legal " + std::string(legal), 200000, [&]() {
+		board b = mid; sink += b.place(legal, who);
+	});
+	measure("copy + place occupied " + std::string(occupied), 200000, [&]() {
+		board b = mid; sink += b.place(occupied, who);
+	});
+	measure("copy + place suicide/take " + std::string(suicide), 200000, [&]() {
+		board b = mid; sink += b.place(suicide, who);
+	});
+
+	std::cout << "board::check_liberty" << std::endl;
+	for (size_t size : { 1, 4, 16, 32 }) {
+		board b = chain(size);
+		measure("chain of " + std::to_string(size), 100000, [&]() { sink += b.check_liberty(0, 0, board::black); });
+	}
+
+	std::cout << "action::place::apply" << std::endl;
+	measure("direct action::place", 200000, [&]() {
+		board b = mid; sink += action::place(legal, who).apply(b);
+	});
+	measure("prototype dispatch via action", 200000, [&]() {
+		board b = mid; action a = action::place(legal, who); sink += a.apply(b);
+	});
+	measure("compact board::move", 200000, [&]() {
+		board b = mid; sink += b.place(board::move(legal.i, who));
+	});
+
+	std::cout << "network::value" << std::endl;
+	for (size_t hidden : { 32, 64, 128, 200 }) {
+		// a network of random weights, since only the inference time matters here
+		std::vector<float> weights((network::inputs + 2) * hidden + 1 + (hidden + 1) * network::outputs);
+		std::default_random_engine engine(hidden);
+		std::normal_distribution<float> weight(0, 0.1);
+		for (float& w : weights) w = weight(engine);
+		char path[] = "/tmp/microbench-XXXXXX";
+		int fd = mkstemp(path);
+		if (fd < 0) throw std::runtime_error("cannot create a temporary file");
+		close(fd);
+		std::unique_ptr<network> net;
+		try {
+			network::save(path, hidden, weights);
+			net.reset(new network(path));
+		} catch (...) {
+			std::remove(path);
+			throw;
+		}
+		std::remove(path);
+		measure("hidden " + std::to_string(hidden), 100000, [&]() { sink += net->value(mid) > 0.5f; });
+
+		// the AVX2 kernels must agree with the portable ones, up to the rounding of the summation order
+		float most = 0;
+		for (const std::string& position : benchmark::suite())
+			most = std::max(most, net->discrepancy(replay(position)));
+		std::cout << std::left << std::setw(40) << "AVX2 vs portable kernels" << std::scientific << std::setprecision(2)
+		          << "max diff = " << most << (most <= 1e-3f ? " ok" : " MISMATCH") << std::endl;
+		if (most > 1e-3f) return 1;
+	}
+
+	std::cout << "episode::apply_action" << std::endl;
+	std::vector<action> moves;
+	{
+		board state;
+		std::stringstream ss(game);
+		for (std::string move; ss >> move; ) {
+			moves.push_back(action::place(board::point(move), state.info().who_take_turns));
+			state.place(board::point(move));
+		}
+	}
+	measure("replay " + std::to_string(moves.size()) + " moves (per game)", 2000, [&]() {
+		episode ep;
+		for (const action& move : moves) sink += ep.apply_action(move);
+	});
+
+	std::cout << "statistics serialization" << std::endl;
+	episode ep;
+	ep.open_episode("black:white");
+	for (const action& move : moves) ep.apply_action(move);
+	ep.close_episode("white");
+	std::string rec;
+	{
+		std::stringstream ss;
+		ss << ep;
+		rec = ss.str();
+	}
+	measure("episode write", 20000, [&]() { std::stringstream ss; ss << ep; sink += ss.tellp(); });
+	measure("episode read", 20000, [&]() { episode e; std::stringstream(rec) >> e; sink += e.step(); });
+	measure("statistics round-trip (100 episodes)", 20, [&]() {
+		statistics stats(100);
+		std::stringstream ss;
+		for (size_t i = 0; i < 100; i++) ss << rec << std::endl;
+		ss >> stats;
+		std::stringstream out;
+		out << stats;
+		sink += out.tellp();
+	});
+
+	return 0;
+}
@@ -0,0 +1,278 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * network.h: Small value and policy network with SIMD inference on the CPU
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <stdexcept>
+#include "board.h"
+#if defined(__AVX2__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/**
+ * a multilayer perceptron with one hidden layer of ReLU units, a value head and a policy head
+ *
+ * the input is three planes over the board in 1-d array style, from the view of the side to move,
+ * i.e., input (plane * 81 + i) is 1 if point i is a stone of the side to move (plane 0), a stone of
+ * the opponent (plane 1), or empty (plane 2), and hollow points have no input; this matches the
+ * cells and the color of a dataset sample
+ *
+ * the layout of a weight file (native byte order, 32-bit floats) is a 24-byte header followed by
+ *
+ *   w1[inputs][hidden] | b1[hidden] | wv[hidden] | bv | wp[outputs][hidden] | bp[outputs]
+ *
+ * where the value is sigmoid(wv . h + bv), the winning probability of the side to move,
+ * and the policy is the softmax of (wp . h + bp) over the empty points
+ */
+class network {
+public:
+	enum magic : uint64_t { file_magic = 0x3154454e4f474f4eull }; // "NOGONET1"
+	enum { planes = 3, cells = board::size_x * board::size_y, inputs = planes * cells, outputs = cells };
+
+	struct header {
+		uint64_t magic;
+		uint32_t inputs;
+		uint32_t hidden;
+		uint32_t outputs;
+		uint32_t reserved;
+	};
+
+public:
+	network(const std::string& path) : hidden(0), width(0), bv(0) {
+		std::FILE* file = std::fopen(path.c_str(), "rb");
+		if (!file) throw std::runtime_error("cannot open " + path);
+		header h = {};
+		bool ok = std::fread(&h, sizeof(h), 1, file) == 1 && h.magic == file_magic
+		          && h.inputs == inputs && h.outputs == outputs && h.hidden > 0;
+		if (ok) {
+			hidden = h.hidden;
+			width = (hidden + 7) & ~size_t(7); // pad the hidden layer to whole vectors
+			w1.assign(inputs * width, 0);
+			b1.assign(width, 0);
+			wv.assign(width, 0);
+			wp.assign(outputs * width, 0);
+			bp.assign(outputs, 0);
+			for (size_t f = 0; ok && f < inputs; f++) ok = read(file, &w1[f * width], hidden);
+			ok = ok && read(file, b1.data(), hidden) && read(file, wv.data(), hidden) && read(file, &bv, 1);
+			for (size_t k = 0; ok && k < outputs; k++) ok = read(file, &wp[k * width], hidden);
+			ok = ok && read(file, bp.data(), outputs);
+		}
+		std::fclose(file);
+		if (!ok) throw std::runtime_error("not a network file: " + path);
+	}
+
+	/**
+	 * load a network file once, and share it among all players using the same path
+	 */
+	static std::shared_ptr<const network> load(const std::string& path) {
+		static std::map<std::string, std::weak_ptr<const network>> cache;
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock(mutex);
+		std::shared_ptr<const network> net = cache[path].lock();
+		if (!net) cache[path] = net = std::make_shared<const network>(path);
+		return net;
+	}
+
+public:
+	/**
+	 * the winning probability of the side to move
+	 */
+	float value(const board& state) const {
+		float h[width];
+		forward(state, h);
+		return 1 / (1 + std::exp(-(dot(h, wv.data(), width) + bv)));
+	}
+
+	/**
+	 * the winning probabilities of the sides to move of several states, evaluated together so that
+	 * each block of the weights is shared by all states while it is in the cache
+	 */
+	void values(const board* const states[], size_t n, float out[]) const {
+		if (n == 0) return;
+		int active[n][cells], count[n];
+		float h[n][width];
+		for (size_t b = 0; b < n; b++) count[b] = features(*states[b], active[b]);
+		for (size_t j = 0; j < width; j += block)
+			for (size_t b = 0; b < n; b++) forward(h[b], active[b], count[b], j, std::min(j + block, width));
+		for (size_t b = 0; b < n; b++) out[b] = 1 / (1 + std::exp(-(dot(h[b], wv.data(), width) + bv)));
+	}
+
+	/**
+	 * the move probabilities of the side to move over the empty points, in 1-d array style
+	 */
+	void policy(const board& state, float prob[outputs]) const {
+		float h[width];
+		forward(state, h);
+		float max = -INFINITY, sum = 0;
+		for (size_t k = 0; k < outputs; k++) {
+			prob[k] = state(k) == board::empty ? dot(h, &wp[k * width], width) + bp[k] : -INFINITY;
+			max = std::max(max, prob[k]);
+		}
+		for (size_t k = 0; k < outputs; k++) sum += (prob[k] = prob[k] > -INFINITY ? std::exp(prob[k] - max) : 0);
+		for (size_t k = 0; k < outputs; k++) prob[k] /= sum;
+	}
+
+	size_t size() const { return hidden; }
+
+	/**
+	 * write a network file of the given hidden size, where the weights are all floats in the file order
+	 */
+	static void save(const std::string& path, uint32_t hidden, const std::vector<float>& weights) {
+		if (weights.size() != (inputs + 2) * size_t(hidden) + 1 + (hidden + 1) * size_t(outputs))
+			throw std::invalid_argument("invalid number of weights for " + std::to_string(hidden) + " hidden units");
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if (!file) throw std::runtime_error("cannot open " + path);
+		header h = { file_magic, inputs, hidden, outputs, 0 };
+		bool ok = std::fwrite(&h, sizeof(h), 1, file) == 1
+		          && std::fwrite(weights.data(), sizeof(float), weights.size(), file) == weights.size();
+		ok = std::fclose(file) == 0 && ok;
+		if (!ok) throw std::runtime_error("cannot write " + path);
+	}
+
+	/**
+	 * the largest difference between the AVX2 and the portable kernels on a state, over the hidden units,
+	 * the value logit and the policy logits, or 0 if the kernels are not built or not supported
+	 */
+	float discrepancy(const board& state) const {
+		float most = 0;
+#if defined(__AVX2__) || defined(__x86_64__)
+		if (!avx2()) return 0;
+		int active[cells];
+		int count = features(state, active);
+		float h[width], g[width];
+		forward_scalar(h, active, count, 0, width);
+		forward_avx2(g, active, count, 0, width);
+		for (size_t j = 0; j < width; j++) most = std::max(most, std::abs(h[j] - g[j]));
+		most = std::max(most, std::abs(dot_scalar(h, wv.data(), width) - dot_avx2(h, wv.data(), width)));
+		for (size_t k = 0; k < outputs; k++)
+			most = std::max(most, std::abs(dot_scalar(h, &wp[k * width], width) - dot_avx2(h, &wp[k * width], width)));
+#endif
+		return most;
+	}
+
+protected:
+	/**
+	 * the offsets of the weight columns of the active inputs, return the number of active inputs
+	 */
+	int features(const board& state, int active[]) const {
+		unsigned who = state.info().who_take_turns;
+		int count = 0;
+		for (int i = 0; i < cells; i++) {
+			unsigned cell = state(i);
+			if (cell == board::hollow) continue;
+			int plane = cell == board::empty ? 2 : (cell == who ? 0 : 1);
+			active[count++] = (plane * cells + i) * width;
+		}
+		return count;
+	}
+
+	void forward(const board& state, float h[]) const {
+		int active[cells];
+		forward(h, active, features(state, active), 0, width);
+	}
+
+	/**
+	 * the hidden units in [from, to), computed as the bias plus the sum of the weight columns of
+	 * the active inputs, since the input is sparse and binary
+	 */
+	void forward(float h[], const int active[], int count, size_t from, size_t to) const {
+#if defined(__AVX2__) || defined(__x86_64__)
+		if (avx2()) return forward_avx2(h, active, count, from, to);
+#endif
+		forward_scalar(h, active, count, from, to);
+	}
+
+	void forward_scalar(float h[], const int active[], int count, size_t from, size_t to) const {
+		std::copy(&b1[from], &b1[to], h + from);
+		for (int k = 0; k < count; k++)
+			for (size_t j = from; j < to; j++) h[j] += w1[active[k] + j];
+		for (size_t j = from; j < to; j++) h[j] = std::max(h[j], 0.0f);
+	}
+
+#if defined(__AVX2__) || defined(__x86_64__)
+	/**
+	 * the hidden units with AVX2, which keeps 64 units in registers while summing the columns,
+	 * so that the sums do not go through the memory
+	 */
+	__attribute__((target("avx2,fma")))
+	void forward_avx2(float h[], const int active[], int count, size_t from, size_t to) const {
+		const float* w = w1.data();
+		__m256 zero = _mm256_setzero_ps();
+		size_t j = from;
+		for (; j + 64 <= to; j += 64) {
+			__m256 a[8];
+			for (int v = 0; v < 8; v++) a[v] = _mm256_loadu_ps(&b1[j + v * 8]);
+			for (int k = 0; k < count; k++) {
+				const float* x = w + active[k] + j;
+				for (int v = 0; v < 8; v++) a[v] = _mm256_add_ps(a[v], _mm256_loadu_ps(x + v * 8));
+			}
+			for (int v = 0; v < 8; v++) _mm256_storeu_ps(h + j + v * 8, _mm256_max_ps(a[v], zero));
+		}
+		for (; j < to; j += 8) {
+			__m256 a = _mm256_loadu_ps(&b1[j]);
+			for (int k = 0; k < count; k++) a = _mm256_add_ps(a, _mm256_loadu_ps(w + active[k] + j));
+			_mm256_storeu_ps(h + j, _mm256_max_ps(a, zero));
+		}
+	}
+#endif
+
+	static bool read(std::FILE* file, float* data, size_t n) {
+		return std::fread(data, sizeof(float), n, file) == n;
+	}
+
+	static float dot(const float* x, const float* y, size_t n) {
+#if defined(__AVX2__) || defined(__x86_64__)
+		if (avx2()) return dot_avx2(x, y, n);
+#endif
+		return dot_scalar(x, y, n);
+	}
+
+	static float dot_scalar(const float* x, const float* y, size_t n) {
+		float sum = 0;
+		for (size_t i = 0; i < n; i++) sum += x[i] * y[i];
+		return sum;
+	}
+
+#if defined(__AVX2__) || defined(__x86_64__)
+	/**
+	 * the kernels use AVX2 if the CPU supports it, where the lengths are multiples of 8
+	 * they are only built for x86, and the portable loops are used elsewhere
+	 */
+	static bool avx2() {
+		static const bool support = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+		return support;
+	}
+
+	__attribute__((target("avx2,fma")))
+	static float dot_avx2(const float* x, const float* y, size_t n) {
+		__m256 sum = _mm256_setzero_ps();
+		for (size_t i = 0; i < n; i += 8)
+			sum = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), sum);
+		__m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+		half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+		return _mm_cvtss_f32(half);
+	}
+#endif
+
+private:
+	size_t hidden; // number of hidden units
+	size_t width; // number of hidden units padded to a multiple of 8
+	static constexpr size_t block = 64; // number of hidden units of a state computed at a time in a batch
+	std::vector<float> w1, b1, wv, wp, bp; // w1 is stored by input, and wp by output
+	float bv;
+};
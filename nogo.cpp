@@ -16,17 +16,27 @@
 #include "agent.h"
 #include "episode.h"
 #include "statistics.h"
+#include "arena.h"
+#include "bench.h"
+#include "perft.h"
+#include "shell.h"
+#include "server.h"
+#include "sweep.h"
+#include "review.h"
+#include "trainer.h"
 
 int main(int argc, const char* argv[]) {
-	std::cout << "HollowNoGo-Demo: ";
-	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cout, " "));
-	std::cout << std::endl << std::endl;
-
-	size_t total = 1000, block = 0, limit = 0;
+	size_t total = 1000, block = 0, limit = 0, threads = 1, procs = 0;
 	std::string black_args, white_args;
-	std::string load_path, save_path;
+	std::string load_path, save_path, record_path;
+	std::string sprt_args;
 	std::string name = "TCG-HollowNoGo-Demo", version = "2022"; // for GTP shell
-	bool shell = false;
+	std::string bench_path, perft_args;
+	std::string export_path;
+	std::string sweep_path, review_path;
+	std::string train_args;
+	bool augment = false;
+	bool shell = false, server = false, bench = false, stream = false, sweeping = false;
 	for (int i = 1; i < argc; i++) {
 		std::string arg = argv[i];
 		auto match_arg = [&](std::string flag) -> bool {
@@ -43,6 +53,12 @@ int main(int argc, const char* argv[]) {
 			block = std::stoull(next_opt());
 		} else if (match_arg("limit")) {
 			limit = std::stoull(next_opt());
+		} else if (match_arg("threads")) {
+			threads = std::stoull(next_opt());
+		} else if (match_arg("procs")) {
+			procs = std::stoull(next_opt());
+		} else if (match_arg("sprt")) {
+			sprt_args = next_opt();
 		} else if (match_arg("black")) {
 			black_args = next_opt();
 		} else if (match_arg("white")) {
@@ -51,147 +67,136 @@ int main(int argc, const char* argv[]) {
 			load_path = next_opt();
 		} else if (match_arg("save")) {
 			save_path = next_opt();
+		} else if (match_arg("record")) {
+			record_path = next_opt();
+		} else if (match_arg("export")) {
+			export_path = next_opt();
+		} else if (match_arg("augment")) {
+			augment = true;
 		} else if (match_arg("name")) {
 			name = next_opt();
 		} else if (match_arg("version")) {
 			version = next_opt();
+		} else if (match_arg("stream")) {
+			stream = true;
 		} else if (match_arg("shell")) {
 			shell = true;
+		} else if (match_arg("server")) {
+			server = true;
+		} else if (match_arg("bench")) {
+			bench = true;
+			if (arg.find('=') != std::string::npos) bench_path = next_opt();
+		} else if (match_arg("perft")) {
+			perft_args = next_opt();
+		} else if (match_arg("train")) {
+			train_args = next_opt();
+		} else if (match_arg("review")) {
+			review_path = next_opt();
+		} else if (match_arg("sweep")) {
+			sweeping = true;
+			if (arg.find('=') != std::string::npos) sweep_path = next_opt();
 		}
 	}
 
-	statistics stats(total, block, limit);
-
-	if (load_path.size()) {
-		std::ifstream in(load_path, std::ios::in);
-		in >> stats;
-		in.close();
-		if (stats.is_finished()) stats.summary();
+	std::ostream& banner = bench ? std::cerr : std::cout; // keep the JSON lines of the benchmark alone on stdout
+	banner << "HollowNoGo-Demo: ";
+	std::copy(argv, argv + argc, std::ostream_iterator<const char*>(banner, " "));
+	banner << std::endl << std::endl;
+
+	if (bench) { // run the fixed-position search benchmark with the black arguments
+		benchmark suite(black_args);
+		if (bench_path.size()) {
+			std::ifstream in(bench_path, std::ios::in);
+			if (!in) throw std::invalid_argument("cannot open " + bench_path);
+			suite.load(in);
+		}
+		suite.run(std::cout);
+		return 0;
 	}
 
-	player black("name=black " + black_args + " role=black");
-	player white("name=white " + white_args + " role=white");
-
-	if (!shell) { // launch standard local games
-		while (!stats.is_finished()) {
-//			std::cerr << "======== Game " << stats.step() << " ========" << std::endl;
-			black.open_episode("~:" + white.name());
-			white.open_episode(black.name() + ":~");
+	if (train_args.size()) { // fit the network to an exported dataset, e.g., --train="data=train.bin weights=value.net"
+		trainer fit(train_args);
+		fit.run(std::cout);
+		return 0;
+	}
 
-			stats.open_episode(black.name() + ":" + white.name());
-			episode& game = stats.back();
-			while (true) {
-				agent& who = game.take_turns(black, white);
-				action move = who.take_action(game.state());
-//				std::cerr << game.state() << "#" << game.step() << " " << who.name() << ": " << move << std::endl;
-				if (game.apply_action(move) != true) break;
-				if (who.check_for_win(game.state())) break;
-			}
-			agent& win = game.last_turns(black, white);
-			stats.close_episode(win.name());
+	if (perft_args.size()) { // walk the game tree of the benchmark suite, e.g., --perft=3 or --perft=3,verify
+		perft walker(perft_args.find("verify") != std::string::npos);
+		return walker.run(std::cout, std::stoi(perft_args)) ? 1 : 0;
+	}
 
-			black.close_episode(win.name());
-			white.close_episode(win.name());
+	if (sweeping) { // play --total games for each configuration of a file, or of the black and white arguments
+		sweep runner;
+		if (sweep_path.size()) {
+			std::ifstream in(sweep_path, std::ios::in);
+			if (!in) throw std::invalid_argument("cannot open " + sweep_path);
+			runner.load(in);
+		} else {
+			runner.add(black_args + " | " + white_args);
 		}
-	} else { // launch GTP shell
-		for (std::string command; std::getline(std::cin, command); ) {
-			if (command.back() == '\r') command.pop_back();
-			if (command.empty()) continue;
-
-			std::vector<std::string> args;
-			std::istringstream iss(command);
-			for (std::string s; getline(iss, s, ' '); args.push_back(s));
-
-			std::string reply;
-			if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
-				if (!stats.is_episode_ongoing()) { // should open an episode
-					black.open_episode("~:" + white.name());
-					white.open_episode(black.name() + ":~");
-					stats.open_episode(black.name() + ":" + white.name());
-				}
-
-				episode& game = stats.back();
-				agent& who = game.take_turns(black, white);
-				if (who.role()[0] != std::tolower(args[1][0])) { // player mismatch?!
-					std::cout << "= " << "resign" << std::endl << std::endl;
-					// show the error message and terminate the shell
-					std::cerr << "player color " << args[1] << " mismatch!" << std::endl;
-					std::cerr << "current state, "
-					          << who.role() << " to play: " << std::endl << game.state();
-					break;
-				}
-				if (args[0] == "play") { // play a move
-					std::string types = "?bw"; // black == 1, white == 2
-					action::place move(args[2], types.find(who.role()[0]));
-					if (game.apply_action(move) != true) { // remote plays an illegal move?!
-						std::cout << "= " << "resign" << std::endl << std::endl;
-						// show the error message and terminate the shell
-						std::cerr << who.role() << " plays an illegal action!" << std::endl;
-						const char* reason[] = {
-							"legal",
-							"illegal_turn",
-							"illegal_pass",
-							"illegal_out_of_range",
-							"illegal_not_empty",
-							"illegal_suicide",
-							"illegal_take",
-							"unknown",
-						};
-						std::cerr << "current state: " << std::endl << game.state();
-						int code = move.apply(game.state());
-						std::cerr << "action: " << args[1] << " " << args[2] << std::endl;
-						std::cerr << "reason: " << reason[std::min(-code, 7)] << std::endl;
-						break;
-					}
-				} else if (args[0] == "genmove") { // generate a move and play
-					action::place move = who.take_action(game.state());
-					if (game.apply_action(move) == true) {
-						reply = move.position();
-					} else { // I have no legal move to play
-						reply = "resign";
-					}
-				}
+		runner.run(std::cout, total, threads);
+		return 0;
+	}
 
-			} else if (args[0] == "clear_board" || args[0] == "quit") { // reset game, or quit
-				if (stats.is_episode_ongoing()) { // should close an opened episode
-					agent& win = stats.back().last_turns(black, white);
-					stats.close_episode(win.name());
-					black.close_episode(win.name());
-					white.close_episode(win.name());
-				}
-				if (args[0] == "quit") break; // quit GTP shell
+	statistics stats(total, block, limit);
 
-			} else if (args[0] == "showboard") { // print the board
-				std::stringstream buf;
-				buf << (stats.is_episode_ongoing() ? stats.back().state() : board());
-				reply = "\n" + buf.str();
-				reply.pop_back(); // remove a new line
+	if (sprt_args.size()) { // elo0,elo1[,alpha,beta]
+		std::vector<double> v = { 0, 0, 0.05, 0.05 };
+		std::stringstream ss(sprt_args);
+		std::string s;
+		size_t k = 0;
+		for (; k < v.size() && std::getline(ss, s, ','); k++) v[k] = std::stod(s);
+		if (k < 2) throw std::invalid_argument("invalid sprt: " + sprt_args + ", expect elo0,elo1[,alpha,beta]");
+		stats.sprt(v[0], v[1], v[2], v[3]);
+	}
 
-			} else if (args[0] == "boardsize") { // set the board size
-				size_t size = std::stoul(args[1]);
-				if (size != board::size_x || size != board::size_y) {
-					std::cerr << "board size mismatch: " << args[1] << std::endl;
-				}
-				if (size > board::size_x || size > board::size_y) break;
+	if (load_path.size()) {
+		if (record::is_record(load_path)) { // binary record file
+			stats.load(std::make_shared<const record_reader>(load_path), threads);
+		} else {
+			stats.load(load_path, threads);
+		}
+		if (stats.is_finished()) stats.summary();
+	}
 
-			} else if (args[0] == "name") { // report the name of the program
-				reply = name;
-			} else if (args[0] == "version") { // report the version number of the program
-				reply = version;
-			} else if (args[0] == "protocol_version") { // report GTP protocol version
-				reply = "2";
-			} else if (args[0] == "list_commands") { // print supported commands
-				reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n"
-				        "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n";
-			} else {
-				reply = "unknown command";
-			}
+	if (review_path.size()) { // search every position of the loaded games with the black arguments, and annotate the moves
+		review reviewer(black_args);
+		std::ofstream out(review_path, std::ios::out | std::ios::trunc);
+		reviewer.run(stats, out, std::cout, threads);
+		return 0;
+	}
 
-			std::cout << "= " << reply << std::endl << std::endl;
+	if (record_path.size()) {
+		record::check(agent("name=black " + black_args).name()); // before any game is played
+		record::check(agent("name=white " + white_args).name());
+		stats.record(record_path);
+	}
+	if (stream && save_path.size()) stats.stream(save_path);
+
+	if (server) { // launch the multiplexed GTP server, with a pool of threads shared by all games
+		gtp_server gtp(stats, black_args, white_args, name, version, threads);
+		gtp.run(std::cin, std::cout);
+	} else if (!shell) { // launch standard local games
+		arena local(black_args, white_args);
+		std::unique_ptr<dataset> samples;
+		if (export_path.size()) {
+			if (procs) throw std::invalid_argument("--export is not supported with --procs");
+			player::check("name=black " + black_args + " role=black", "--export"); // before the writer thread starts
+			player::check("name=white " + white_args + " role=white", "--export");
+			samples.reset(new dataset(export_path));
+			local.record(samples.get(), augment);
 		}
+		if (procs) local.spawn(stats, procs);
+		else       local.run(stats, threads);
+#ifdef COUNTERS
+		stats.summary(); // show the hot-path counters of this run
+#endif
+	} else { // launch GTP shell
+		gtp_shell gtp(stats, black_args, white_args, name, version);
+		gtp.run(std::cin, std::cout);
 	}
 
-	if (save_path.size()) {
+	if (save_path.size() && !stats.is_streaming()) {
 		std::ofstream out(save_path, std::ios::out | std::ios::trunc);
 		out << stats;
 		out.close();
@@ -0,0 +1,154 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * perft.h: Legal move enumeration harness for validating and timing the board
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include "board.h"
+#include "bench.h"
+
+class perft {
+public:
+	/**
+	 * when verify is set, the result of board::place on every point of every visited node
+	 * is checked against the reference rules, which are kept apart from the board
+	 */
+	perft(bool verify = false) : verify(verify), mismatch(0) {}
+
+public:
+	/**
+	 * walk the game tree of each position of the benchmark suite from depth 1 to depth,
+	 * and compare the leaf counts with the expected table
+	 *
+	 * the format of a line is
+	 * position=2 depth=3 leaves=131880 msec=68.9 nps=1951020 ok
+	 *
+	 * return the number of mismatches
+	 */
+	size_t run(std::ostream& out, int depth) {
+		typedef std::chrono::steady_clock clock;
+		std::vector<std::string> suite = benchmark::suite();
+		size_t failed = 0;
+		for (size_t k = 0; k < suite.size(); k++) {
+			board state;
+			std::stringstream ss(suite[k]);
+			for (std::string move; ss >> move; state.place(board::point(move)));
+
+			for (int d = 1; d <= depth; d++) {
+				mismatch = 0;
+				nodes = 0;
+				auto start = clock::now();
+				size_t leaves = walk(state, d);
+				double ms = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+				out << "position=" << k << " depth=" << d << " leaves=" << leaves
+				    << " msec=" << ms << " nps=" << (nodes * 1000.0 / ms);
+				size_t expect = expected(k, d);
+				if (expect != size_t(-1) && expect != leaves) {
+					out << " MISMATCH (expected " << expect << ")";
+					failed++;
+				} else if (mismatch) {
+					out << " MISMATCH (" << mismatch << " points differ from the reference)";
+					failed++;
+				} else {
+					out << (expect != size_t(-1) ? " ok" : " unknown");
+				}
+				out << std::endl;
+			}
+		}
+		return failed;
+	}
+
+	/**
+	 * count the leaves at the given depth, where a position without a legal move is not a leaf
+	 */
+	size_t walk(const board& state, int depth) {
+		nodes++;
+		if (depth == 0) return 1;
+		size_t leaves = 0;
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			board after = state;
+			board::reward r = after.place(board::point(i));
+			if (verify && r != reference(state, board::point(i))) mismatch++;
+			if (r == board::legal) leaves += walk(after, depth - 1);
+		}
+		return leaves;
+	}
+
+	/**
+	 * the reference rules of placing a stone for the side to move, built on their own flood fill, so that
+	 * a change of board::place or board::check_liberty is checked against rules it does not share
+	 */
+	static board::reward reference(const board& state, const board::point& p) {
+		unsigned who = state.info().who_take_turns;
+		if (p.x < 0 || p.x >= board::size_x || p.y < 0 || p.y >= board::size_y) return board::illegal_out_of_range;
+		if (state[p.x][p.y] == board::hollow) return board::illegal_out_of_range;
+		if (state[p.x][p.y] != board::empty) return board::illegal_not_empty;
+		board test = state;
+		test[p.x][p.y] = who;
+		if (!breathes(test, p.x, p.y)) return board::illegal_suicide;
+		const int dx[] = { -1, 1, 0, 0 }, dy[] = { 0, 0, -1, 1 };
+		for (int d = 0; d < 4; d++) {
+			int x = p.x + dx[d], y = p.y + dy[d];
+			if (x < 0 || x >= board::size_x || y < 0 || y >= board::size_y) continue;
+			if (test[x][y] == 3u - who && !breathes(test, x, y)) return board::illegal_take;
+		}
+		return board::legal;
+	}
+
+	/**
+	 * whether the chain of the stone at (x, y) has a liberty, by a plain flood fill
+	 */
+	static bool breathes(const board& state, int x, int y) {
+		unsigned who = state[x][y];
+		bool seen[board::size_x][board::size_y] = {};
+		std::vector<std::pair<int, int>> stack = { { x, y } };
+		seen[x][y] = true;
+		const int dx[] = { -1, 1, 0, 0 }, dy[] = { 0, 0, -1, 1 };
+		while (stack.size()) {
+			int px = stack.back().first, py = stack.back().second;
+			stack.pop_back();
+			for (int d = 0; d < 4; d++) {
+				int qx = px + dx[d], qy = py + dy[d];
+				if (qx < 0 || qx >= board::size_x || qy < 0 || qy >= board::size_y || seen[qx][qy]) continue;
+				if (state[qx][qy] == board::empty) return true;
+				if (state[qx][qy] == who) {
+					seen[qx][qy] = true;
+					stack.emplace_back(qx, qy);
+				}
+			}
+		}
+		return false;
+	}
+
+	/**
+	 * the expected leaf counts of the benchmark suite on the 9x9 hollow board, or -1 if unknown
+	 */
+	static size_t expected(size_t position, int depth) {
+		static const std::vector<std::vector<size_t>> table = {
+			// depth 1, 2, 3, 4
+			{ 73, 5256, 373160, 26117840 },
+			{ 66, 4289, 274280, 17259476 },
+			{ 52, 2647, 131880, 6429864 },
+			{ 40, 1595, 60280, 2262788 },
+			{ 28, 751, 19078, 468464 },
+			{ 15, 193, 2372, 25264 },
+		};
+		if (position >= table.size() || depth < 1 || size_t(depth) > table[position].size()) return -1;
+		return table[position][depth - 1];
+	}
+
+private:
+	bool verify;
+	size_t mismatch;
+	size_t nodes;
+};
@@ -0,0 +1,296 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * record.h: Compact binary format for storing episodes
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "action.h"
+#include "episode.h"
+
+/**
+ * the layout of a record file (native byte order) is
+ *
+ *   file header | record | record | ... | record | index | trailer
+ *
+ * where each record is a fixed header followed by one byte (the position) per move,
+ * the index is the file offsets of all records, and the trailer locates the index
+ *
+ * the index and the trailer are written when the writer is closed, and are removed
+ * when the file is opened again for appending; a file without them, e.g., from an
+ * interrupted process, is still readable by scanning the records from the beginning
+ */
+class record {
+public:
+	enum magic : uint64_t {
+		file_magic = 0x314345524f474f4eull, // "NOGOREC1"
+		index_magic = 0x315844494f474f4eull, // "NOGOIDX1"
+		record_magic = 0x5045474eull, // "NGEP"
+	};
+
+	struct file_header {
+		uint64_t magic;
+		uint8_t size_x, size_y;
+		uint16_t header_size;
+		uint32_t reserved;
+	};
+
+	struct header {
+		uint32_t magic;
+		uint16_t moves; // number of moves, i.e., bytes following this header
+		uint8_t winner; // board::black or board::white
+		uint8_t reserved;
+		int64_t open, close; // time of opening and closing the episode in milliseconds
+		uint32_t black_time, white_time; // total thinking time of black and white in milliseconds
+		char black[24], white[24]; // player names, null-terminated, see check()
+	};
+
+	struct trailer {
+		uint64_t count;
+		uint64_t index;
+		uint64_t magic;
+	};
+
+public:
+	/**
+	 * reject a player name that does not fit in a header, so that a record keeps the names of its episode
+	 */
+	static void check(const std::string& name) {
+		if (name.size() >= sizeof(header::black))
+			throw std::invalid_argument("player name longer than " + std::to_string(sizeof(header::black) - 1)
+			                            + " bytes cannot be recorded: " + name);
+	}
+
+	/**
+	 * append the binary record of an episode to a buffer
+	 */
+	static void encode(const episode& ep, std::string& buf) {
+		header h = {};
+		h.magic = record_magic;
+		h.moves = ep.ep_moves.size();
+		std::string names = ep.ep_open.tag;
+		std::string black = names.substr(0, names.find(':')), white = names.substr(names.find(':') + 1);
+		check(black), check(white);
+		h.winner = ep.ep_close.tag == black ? board::black : board::white;
+		h.open = ep.ep_open.when;
+		h.close = ep.ep_close.when;
+		h.black_time = ep.time(board::black);
+		h.white_time = ep.time(board::white);
+		black.copy(h.black, sizeof(h.black) - 1);
+		white.copy(h.white, sizeof(h.white) - 1);
+		buf.append(reinterpret_cast<const char*>(&h), sizeof(h));
+		for (const episode::move& mv : ep.ep_moves) buf.push_back(char(mv.code.position()));
+	}
+
+	/**
+	 * decode a binary record into an episode
+	 * note that only the total thinking time of each side is kept, which is assigned to its last move
+	 */
+	static void decode(const header& h, const uint8_t* moves, episode& ep) {
+		ep = {};
+		std::string black(h.black, strnlen(h.black, sizeof(h.black)));
+		std::string white(h.white, strnlen(h.white, sizeof(h.white)));
+		ep.ep_open = { black + ":" + white, h.open };
+		ep.ep_close = { h.winner == board::black ? black : white, h.close };
+		for (size_t i = 0; i < h.moves; i++) {
+			unsigned who = (i % 2) ? board::white : board::black;
+			ep.ep_moves.emplace_back(board::move(moves[i], who), 0, 0);
+		}
+		if (h.moves >= 1) ep.ep_moves[h.moves - 1 - (h.moves - 1) % 2].time = h.black_time;
+		if (h.moves >= 2) ep.ep_moves[h.moves - 1 - h.moves % 2].time = h.white_time;
+		ep.ep_score = 0;
+		ep.account();
+	}
+
+	/**
+	 * check whether a file begins with the record file header
+	 */
+	static bool is_record(const std::string& path) {
+		file_header fh = {};
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+		bool ok = ::read(fd, &fh, sizeof(fh)) == sizeof(fh) && fh.magic == file_magic;
+		::close(fd);
+		return ok;
+	}
+};
+
+/**
+ * map a record file into memory, and decode its episodes on demand
+ */
+class record_reader {
+public:
+	record_reader(const std::string& path) : base(nullptr), length(0), stop(0) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) throw std::runtime_error("cannot open " + path);
+		struct stat st;
+		fstat(fd, &st);
+		length = st.st_size;
+		if (length) {
+			void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED) { ::close(fd); throw std::runtime_error("cannot map " + path); }
+			base = static_cast<const uint8_t*>(p);
+		}
+		::close(fd);
+		record::file_header fh = {};
+		if (length >= sizeof(fh)) std::memcpy(&fh, base, sizeof(fh));
+		if (fh.magic != record::file_magic || fh.size_x != board::size_x || fh.size_y != board::size_y) {
+			unmap();
+			throw std::runtime_error("not a record file: " + path);
+		}
+		if (!load_index()) scan(sizeof(fh));
+	}
+	record_reader(const record_reader&) = delete;
+	record_reader& operator =(const record_reader&) = delete;
+	~record_reader() { unmap(); }
+
+public:
+	size_t size() const { return offsets.size(); }
+	uint64_t offset(size_t i) const { return offsets.at(i); }
+	uint64_t end() const { return stop; }
+
+	/**
+	 * the fixed header of the i-th record, without decoding its moves
+	 */
+	record::header header(size_t i) const {
+		record::header h;
+		std::memcpy(&h, base + offsets.at(i), sizeof(h));
+		return h;
+	}
+
+	/**
+	 * decode the i-th record into an episode
+	 */
+	void decode(size_t i, episode& ep) const {
+		record::decode(header(i), base + offsets.at(i) + sizeof(record::header), ep);
+	}
+	episode at(size_t i) const {
+		episode ep;
+		decode(i, ep);
+		return ep;
+	}
+
+protected:
+	/**
+	 * use the index written by a properly closed writer, return false if there is none
+	 */
+	bool load_index() {
+		record::trailer tr;
+		if (length < sizeof(record::file_header) + sizeof(tr)) return false;
+		std::memcpy(&tr, base + length - sizeof(tr), sizeof(tr));
+		if (tr.magic != record::index_magic) return false;
+		if (tr.index + tr.count * sizeof(uint64_t) + sizeof(tr) != length) return false;
+		offsets.resize(tr.count);
+		std::memcpy(offsets.data(), base + tr.index, tr.count * sizeof(uint64_t));
+		stop = tr.index;
+		return true;
+	}
+
+	/**
+	 * find the records one by one, until the end or a truncated record
+	 */
+	void scan(uint64_t at) {
+		offsets.clear();
+		record::header h;
+		while (at + sizeof(h) <= length) {
+			std::memcpy(&h, base + at, sizeof(h));
+			if (h.magic != record::record_magic || at + sizeof(h) + h.moves > length) break;
+			offsets.push_back(at);
+			at += sizeof(h) + h.moves;
+		}
+		stop = at;
+	}
+
+	void unmap() {
+		if (base) munmap(const_cast<uint8_t*>(base), length);
+		base = nullptr;
+	}
+
+private:
+	const uint8_t* base;
+	uint64_t length;
+	uint64_t stop;
+	std::vector<uint64_t> offsets;
+};
+
+/**
+ * append episodes to a record file as they are closed
+ */
+class record_writer {
+public:
+	record_writer(const std::string& path) : fd(-1), end(0) {
+		fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd < 0) throw std::runtime_error("cannot open " + path);
+		struct stat st;
+		fstat(fd, &st);
+		record::file_header fh = {};
+		if (st.st_size == 0) { // a new file
+			fh = { record::file_magic, board::size_x, board::size_y, sizeof(record::header), 0 };
+			if (::write(fd, &fh, sizeof(fh)) != sizeof(fh)) throw std::runtime_error("cannot write " + path);
+			end = sizeof(fh);
+			return;
+		}
+		if (::pread(fd, &fh, sizeof(fh), 0) != sizeof(fh) || fh.magic != record::file_magic)
+			throw std::runtime_error("not a record file: " + path);
+		// reuse the index if the file was closed properly, or rebuild it by scanning
+		record_reader reader(path);
+		for (size_t i = 0; i < reader.size(); i++) offsets.push_back(reader.offset(i));
+		end = reader.end();
+		if (ftruncate(fd, end) != 0) throw std::runtime_error("cannot truncate " + path);
+	}
+	record_writer(const record_writer&) = delete;
+	record_writer& operator =(const record_writer&) = delete;
+	~record_writer() { close(); }
+
+public:
+	void append(const episode& ep) {
+		buf.clear();
+		record::encode(ep, buf);
+		offsets.push_back(end);
+		write(buf);
+	}
+
+	/**
+	 * write the index and the trailer, and close the file
+	 */
+	void close() {
+		if (fd < 0) return;
+		record::trailer tr = { offsets.size(), end, record::index_magic };
+		buf.assign(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+		buf.append(reinterpret_cast<const char*>(&tr), sizeof(tr));
+		write(buf);
+		::close(fd);
+		fd = -1;
+	}
+
+protected:
+	void write(const std::string& buf) {
+		for (size_t n = 0; n < buf.size(); ) {
+			ssize_t w = ::pwrite(fd, buf.data() + n, buf.size() - n, end + n);
+			if (w < 0 && errno == EINTR) continue;
+			if (w < 0) throw std::runtime_error("cannot write record");
+			n += w;
+		}
+		end += buf.size();
+	}
+
+private:
+	int fd;
+	uint64_t end;
+	std::vector<uint64_t> offsets;
+	std::string buf;
+};
@@ -0,0 +1,184 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * review.h: Offline re-analysis of recorded games with blunder annotations
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "statistics.h"
+#include "arena.h"
+
+/**
+ * a review replays the recorded games, searches every position with a fixed budget, and annotates
+ * each move by the loss of the winning rate of its side, i.e., the mean of the most visited child of
+ * the root minus the mean of the played child, both from the search of the position before the move,
+ * so that the bias of the rollouts toward either side to move cancels; only the children with at
+ * least 'support' of the root visits are trusted, so the moves played from a position are forced to
+ * that share of the visits in the same search, see player::force
+ *
+ * a position solved by the endgame analyzer has an exact value of 0 or 1, and so has the position
+ * after its move, which gives the value of the move; a move whose value is not trusted, e.g., when the
+ * search is interrupted, is not tagged
+ *
+ * a move losing at least 'blunder' is a blunder, and one losing at least 'mistake' is a mistake;
+ * the final position of a game, where the side to move has no legal move, is lost without searching
+ *
+ * the positions of all games are collected first, so that a position shared by games, e.g., of a common
+ * opening, is searched once; the positions are then searched on a pool of threads, where the seed of
+ * each search is derived from the index of the position, so the result does not depend on the threads
+ */
+class review {
+public:
+	review(const std::string& args, double mistake = 0.1, double blunder = 0.2, double support = 0.05)
+		: args(args), mistake(mistake), blunder(blunder), support(support) {
+		player::check("name=review " + args + " role=black", "--review"); // check the arguments before running
+	}
+
+	struct result {
+		double winrate = 0; // of the side to move, i.e., the mean of the most visited child, or the exact value
+		int best = -1; // the move of the search, or -1 if there is no legal move
+		bool exact = false; // whether the winrate is exact, i.e., solved or lost without a legal move
+		float values[board::size_x * board::size_y]; // of the trusted children, or NaN
+	};
+
+public:
+	/**
+	 * review the episodes of the statistics, and write the annotations of all moves, one per line, as
+	 * game  ply  color  move  best  before  after  loss  tag
+	 * then print a summary of each side to the report stream
+	 */
+	void run(statistics& stats, std::ostream& out, std::ostream& report, size_t threads = 1) {
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::vector<size_t>> games(stats.size()); // the position indices of each game, from the opening to the end
+		size_t moves = 0;
+		for (size_t g = 0; g < stats.size(); g++) {
+			board state;
+			games[g].push_back(index(state));
+			for (const action& a : stats.at(g).actions()) {
+				int move = action::place(a).move().position();
+				if (state.place(action::place(a).move()) != board::legal) break;
+				std::vector<int>& from = replies[games[g].back()];
+				if (std::find(from.begin(), from.end(), move) == from.end()) from.push_back(move);
+				games[g].push_back(index(state));
+				moves++;
+			}
+		}
+
+		std::atomic<size_t> next(0);
+		auto worker = [&]() {
+			for (size_t k; (k = next++) < positions.size(); ) {
+				const board& state = positions[k];
+				std::string role = state.info().who_take_turns == board::black ? "black" : "white";
+				player engine("name=review " + arena::seeded(args, k) + " role=" + role);
+				engine.force(replies[k], support);
+				action::place move = engine.take_action(state);
+				result& r = results[k];
+				const player::search_report& rep = engine.report();
+				r.winrate = rep.winrate;
+				r.best = move.action::type() == action::place::type ? move.move().position() : -1;
+				r.exact = rep.solved || r.best == -1;
+				int total = 0;
+				for (int i = 0; i < board::size_x * board::size_y; i++) total += rep.visits[i];
+				int most = 0;
+				for (int i = 0; i < board::size_x * board::size_y; i++) {
+					bool trusted = !r.exact && rep.visits[i] && rep.visits[i] >= support * total;
+					r.values[i] = trusted ? rep.values[i] : NAN;
+					if (trusted && rep.visits[i] > most) r.winrate = rep.values[i], most = rep.visits[i];
+				}
+			}
+		};
+		std::vector<std::thread> pool;
+		for (size_t k = 1; k < std::max<size_t>(threads, 1); k++) pool.emplace_back(worker);
+		worker();
+		for (std::thread& th : pool) th.join();
+
+		struct tally { size_t moves = 0, mistakes = 0, blunders = 0; double loss = 0; } sides[2];
+		out << "#game\tply\tcolor\tmove\tbest\tbefore\tafter\tloss\ttag" << std::endl;
+		out << std::fixed << std::setprecision(4);
+		for (size_t g = 0; g < games.size(); g++) {
+			for (size_t ply = 0; ply + 1 < games[g].size(); ply++) {
+				const board& state = positions[games[g][ply]];
+				const board& after = positions[games[g][ply + 1]];
+				const result& r = results[games[g][ply]];
+				const result& next = results[games[g][ply + 1]];
+				int move = played(state, after);
+				double before = r.winrate;
+				double value = r.exact ? (next.exact ? 1 - next.winrate : NAN) : r.values[move];
+				bool comparable = !std::isnan(value); // both exact, or both means of the same search
+				double loss = before - value;
+				std::string tag = !comparable ? "" : loss >= blunder ? "blunder" : loss >= mistake ? "mistake" : "";
+				tally& t = sides[ply % 2];
+				t.moves++, t.loss += comparable ? std::max(loss, 0.0) : 0;
+				t.mistakes += tag == "mistake", t.blunders += tag == "blunder";
+				out << g << '\t' << ply + 1 << '\t' << (ply % 2 ? 'W' : 'B')
+				    << '\t' << std::string(board::point(move))
+				    << '\t' << (r.best != -1 ? std::string(board::point(r.best)) : "-")
+				    << '\t' << before << '\t';
+				if (comparable) out << value << '\t' << loss;
+				else out << "-\t-";
+				out << '\t' << tag << std::endl;
+			}
+		}
+
+		double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		report << "reviewed " << games.size() << " games, " << moves << " moves, "
+		       << positions.size() << " positions searched (" << (moves + games.size() - positions.size())
+		       << " cached) in " << sec << " seconds" << std::endl;
+		const char* name[] = { "black", "white" };
+		for (int c = 0; c < 2; c++) {
+			const tally& t = sides[c];
+			report << name[c] << ": " << t.moves << " moves, " << t.mistakes << " mistakes, " << t.blunders << " blunders, "
+			       << "average loss = " << (t.moves ? t.loss / t.moves : 0) << std::endl;
+		}
+	}
+
+protected:
+	/**
+	 * the index of a position, which is added if it is new
+	 * the stones imply the side to move, since there is no pass
+	 */
+	size_t index(const board& state) {
+		auto it = cache.find(state);
+		if (it != cache.end()) return it->second;
+		cache.emplace(state, positions.size());
+		positions.push_back(state);
+		results.emplace_back();
+		replies.emplace_back();
+		return positions.size() - 1;
+	}
+
+	/**
+	 * the move from a position to the next
+	 */
+	static int played(const board& state, const board& after) {
+		for (int i = 0; i < board::size_x * board::size_y; i++)
+			if (state(i) != after(i)) return i;
+		return -1;
+	}
+
+private:
+	std::string args;
+	double mistake, blunder;
+	double support; // the minimum share of the root visits of a trusted child
+	std::map<board, size_t> cache; // the index of each distinct position
+	std::vector<board> positions;
+	std::vector<result> results;
+	std::vector<std::vector<int>> replies; // the moves played from each position
+};
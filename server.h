@@ -0,0 +1,350 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * server.h: Multiplexed GTP server hosting many games in one process
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "statistics.h"
+#include "timer.h"
+
+/**
+ * a GTP server whose commands are prefixed by a game id, e.g., "g1 genmove b", and whose replies
+ * carry the id in the GTP style, e.g., "=g1 D7"; each game has its own players, clocks and episode,
+ * and is created by its first command and ended by "<id> quit"
+ *
+ * a pool of worker threads runs one command at a time for each game, taking the games in turn,
+ * so that the searches of concurrent games share the threads fairly; the replies of a game are
+ * in order, while those of different games may interleave
+ *
+ * a leading token is a game id only if it is not a GTP command, so a line beginning with a command,
+ * e.g., "genmove b", is not bound to any game, and is rejected unless it is name, version,
+ * protocol_version, list_commands or quit; these and "<id> stop" are answered at once, and a single
+ * "quit" closes all games and the server
+ *
+ * finished games are committed to the statistics, including the games still open at quit or at the
+ * end of input, while a game ended by an error is dropped
+ */
+class gtp_server {
+public:
+	gtp_server(statistics& stats, const std::string& black_args, const std::string& white_args,
+			const std::string& name, const std::string& version, size_t threads = 1) : stats(stats),
+		black_args(black_args), white_args(white_args), name(name), version(version),
+		threads(std::max<size_t>(threads, 1)), out(&std::cout), closing(false) {}
+
+public:
+	void run(std::istream& in, std::ostream& out) {
+		this->out = &out;
+		player::check("name=black " + black_args + " role=black", "--server"); // check the arguments before serving
+		player::check("name=white " + white_args + " role=white", "--server");
+		std::vector<std::thread> workers;
+		for (size_t k = 0; k < threads; k++) workers.emplace_back(&gtp_server::work, this);
+
+		bool quit = false;
+		for (std::string command; !quit && std::getline(in, command); ) {
+			if (command.size() && command.back() == '\r') command.pop_back();
+			if (command.empty()) continue;
+
+			std::vector<std::string> args;
+			std::istringstream iss(command);
+			for (std::string s; iss >> s; args.push_back(s));
+			if (args.empty()) continue;
+
+			std::string id;
+			if (args.size() > 1 && !known(args[0])) {
+				id = args.front();
+				args.erase(args.begin());
+			}
+			if (!known(args[0])) {
+				fail(id, "unknown command");
+				continue;
+			}
+			std::string reply;
+			if (id.empty() && (args[0] == "stop" || !immediate(args, reply))) {
+				if (args[0] == "quit") quit = true;
+				else fail(id, "game id required");
+			} else if (immediate(args, reply)) {
+				if (args[0] == "stop") stop(id);
+				respond(id, reply);
+			} else {
+				submit(id, args);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& it : games) if (quit) it.second->halt(it.second->issued);
+			closing = true;
+			ready.notify_all();
+		}
+		for (std::thread& worker : workers) worker.join();
+		for (auto& it : games) finish(*(it.second)); // close the ongoing episodes, at quit or at the end of input
+		games.clear();
+	}
+
+protected:
+	/**
+	 * a hosted game and its queued commands
+	 */
+	struct game {
+		std::string id;
+		player black, white;
+		timer clock;
+		episode ep;
+		bool ongoing = false;
+		std::deque<std::pair<size_t, std::vector<std::string>>> pending; // the queued commands with their ids
+		size_t issued = 0; // the id of the last queued command
+		size_t stopped = 0; // the commands with ids up to this are stopped
+		bool scheduled = false; // whether the game is waiting for or held by a worker
+
+		game(const std::string& id, const std::string& black_args, const std::string& white_args) : id(id),
+			black("name=black " + black_args + " role=black"), white("name=white " + white_args + " role=white") {}
+
+		void halt(size_t upto) {
+			stopped = upto;
+			black.interrupt();
+			white.interrupt();
+		}
+	};
+
+	/**
+	 * whether a token is a supported GTP command, i.e., cannot be a game id
+	 */
+	static bool known(const std::string& command) {
+		for (const char* c : { "play", "genmove", "clear_board", "showboard", "boardsize", "time_settings", "time_left",
+		                       "stop", "name", "version", "protocol_version", "list_commands", "quit" })
+			if (command == c) return true;
+		return false;
+	}
+
+	bool immediate(const std::vector<std::string>& args, std::string& reply) {
+		if (args[0] == "stop") { // interrupt the searches of a game
+			return true;
+		} else if (args[0] == "name") { // report the name of the program
+			reply = name;
+			return true;
+		} else if (args[0] == "version") { // report the version number of the program
+			reply = version;
+			return true;
+		} else if (args[0] == "protocol_version") { // report GTP protocol version
+			reply = "2";
+			return true;
+		} else if (args[0] == "list_commands") { // print supported commands
+			reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n" "time_settings\n" "time_left\n"
+			        "stop\n" "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit";
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * queue a command of a game, creating the game if it is new, or failing the command if the players cannot be created
+	 * the game is removed from the table once its quit is queued, so the id can be reused
+	 */
+	void submit(const std::string& id, const std::vector<std::string>& args) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = games.find(id);
+		if (it == games.end()) {
+			std::shared_ptr<game> g;
+			try {
+				g.reset(new game(id, black_args, white_args));
+			} catch (const std::exception& e) { // e.g., helpers=, which cannot be forked by the worker threads
+				fail(id, e.what());
+				return;
+			}
+			it = games.emplace(id, g).first;
+		}
+		std::shared_ptr<game> g = it->second;
+		if (args[0] == "quit") {
+			g->halt(g->issued);
+			games.erase(it);
+		}
+		enqueue(g, args);
+	}
+
+	void stop(const std::string& id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = games.find(id);
+		if (it != games.end()) it->second->halt(it->second->issued);
+	}
+
+	/**
+	 * queue a command, and schedule the game if it is not waiting for or held by a worker
+	 * the caller must hold the lock
+	 */
+	void enqueue(std::shared_ptr<game> g, const std::vector<std::string>& args) {
+		g->pending.emplace_back(++g->issued, args);
+		if (g->scheduled) return;
+		g->scheduled = true;
+		runnable.push_back(g);
+		ready.notify_one();
+	}
+
+	/**
+	 * the worker loop, which runs one command of the first runnable game,
+	 * and puts the game back to the end of the queue if it has more commands
+	 */
+	void work() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true) {
+			ready.wait(lock, [&]() { return runnable.size() || closing; });
+			if (runnable.empty()) break;
+			std::shared_ptr<game> g = runnable.front();
+			runnable.pop_front();
+			size_t seq = g->pending.front().first;
+			std::vector<std::string> args = std::move(g->pending.front().second);
+			g->pending.pop_front();
+			g->black.interrupt(seq <= g->stopped);
+			g->white.interrupt(seq <= g->stopped);
+			lock.unlock();
+
+			std::string reply;
+			bool alive = execute(*g, args, reply);
+			respond(g->id, reply);
+
+			lock.lock();
+			if (!alive) { // the game is terminated by quit or an error
+				auto it = games.find(g->id);
+				if (it != games.end() && it->second == g) games.erase(it);
+				g->pending.clear();
+			}
+			if (g->pending.size()) {
+				runnable.push_back(g);
+				ready.notify_one();
+			} else {
+				g->scheduled = false;
+			}
+		}
+	}
+
+	/**
+	 * execute a command of a game, return false if the game should be ended
+	 */
+	bool execute(game& g, const std::vector<std::string>& args, std::string& reply) {
+		if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
+			if (args.size() < 2) {
+				reply = "syntax error";
+				return true;
+			}
+			if (!g.ongoing) { // should open an episode
+				g.black.open_episode("~:" + g.white.name());
+				g.white.open_episode(g.black.name() + ":~");
+				g.ep = {};
+				g.ep.open_episode(g.black.name() + ":" + g.white.name());
+				g.ongoing = true;
+			}
+
+			agent& who = g.ep.take_turns(g.black, g.white);
+			if (who.role()[0] != std::tolower(args[1][0])) { // player mismatch?!
+				reply = "resign";
+				std::cerr << g.id << ": player color " << args[1] << " mismatch!" << std::endl;
+				return false;
+			}
+			if (args[0] == "play") { // play a move
+				std::string types = "?bw"; // black == 1, white == 2
+				action::place move(args.size() > 2 ? args[2] : "", types.find(who.role()[0]));
+				if (g.ep.apply_action(move) != true) { // remote plays an illegal move?!
+					reply = "resign";
+					std::cerr << g.id << ": " << who.role() << " plays an illegal action!" << std::endl;
+					return false;
+				}
+			} else if (args[0] == "genmove") { // generate a move and play
+				unsigned color = g.ep.state().info().who_take_turns;
+				if (g.clock.limited()) who.notify("budget=" + std::to_string(g.clock.budget(g.ep.state())));
+				auto start = std::chrono::steady_clock::now();
+				action::place move = who.take_action(g.ep.state());
+				auto used = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+				if (g.clock.limited()) g.clock.spend(color, used.count());
+				if (g.ep.apply_action(move) == true) {
+					reply = move.position();
+				} else { // I have no legal move to play
+					reply = "resign";
+				}
+			}
+
+		} else if (args[0] == "clear_board" || args[0] == "quit") { // reset game, or quit
+			finish(g);
+			if (args[0] == "quit") return false;
+
+		} else if (args[0] == "showboard") { // print the board
+			std::stringstream buf;
+			buf << (g.ongoing ? g.ep.state() : board());
+			reply = "\n" + buf.str();
+			reply.pop_back(); // remove a new line
+
+		} else if (args[0] == "time_settings" && args.size() > 3) { // set the time control, in seconds
+			g.clock.settings(std::stod(args[1]) * 1000, std::stod(args[2]) * 1000, std::stoi(args[3]));
+
+		} else if (args[0] == "time_left" && args.size() > 3) { // update the time left of a side, in seconds
+			unsigned color = std::tolower(args[1][0]) == 'b' ? board::black : board::white;
+			g.clock.left(color, std::stod(args[2]) * 1000, std::stoi(args[3]));
+
+		} else if (args[0] == "boardsize" && args.size() > 1) { // set the board size
+			size_t size = std::stoul(args[1]);
+			if (size != board::size_x || size != board::size_y) {
+				std::cerr << g.id << ": board size mismatch: " << args[1] << std::endl;
+			}
+			if (size > board::size_x || size > board::size_y) return false;
+
+		} else {
+			reply = "unknown command";
+		}
+		return true;
+	}
+
+	/**
+	 * close the ongoing episode of a game, and commit it to the statistics
+	 */
+	void finish(game& g) {
+		if (!g.ongoing) return;
+		agent& win = g.ep.last_turns(g.black, g.white);
+		g.ep.close_episode(win.name());
+		g.black.close_episode(win.name());
+		g.white.close_episode(win.name());
+		stats.commit_episode(std::move(g.ep));
+		g.ongoing = false;
+	}
+
+	void respond(const std::string& id, const std::string& reply) {
+		std::lock_guard<std::mutex> lock(output_lock);
+		*out << "=" << id << " " << reply << std::endl << std::endl;
+	}
+
+	void fail(const std::string& id, const std::string& reason) {
+		std::lock_guard<std::mutex> lock(output_lock);
+		*out << "?" << id << " " << reason << std::endl << std::endl;
+	}
+
+private:
+	statistics& stats;
+	std::string black_args, white_args;
+	std::string name, version;
+	size_t threads;
+	std::ostream* out;
+
+	std::map<std::string, std::shared_ptr<game>> games; // the games that accept commands, by id
+	std::deque<std::shared_ptr<game>> runnable; // the games with queued commands, in turn
+	bool closing;
+	std::mutex mutex; // for the games, their queued commands, and the runnable queue
+	std::mutex output_lock;
+	std::condition_variable ready;
+};
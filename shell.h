@@ -0,0 +1,327 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * shell.h: Asynchronous GTP shell with an interruptible engine
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "statistics.h"
+#include "timer.h"
+
+/**
+ * the GTP shell is split into a reader and an engine, joined by a command queue
+ *
+ * the reader answers name, version, protocol_version, list_commands, showboard and stop at once,
+ * even while the engine is searching, and queues the other commands for the engine in order;
+ * since a controller without command ids matches the replies by their order, such a command is
+ * only answered at once when no reply is pending, and is queued behind the pending ones otherwise,
+ * while a command with a numeric id, e.g., "7 name", is always answered at once as "=7 ..."
+ *
+ * stop interrupts the running search and the searches of all queued commands, which then play
+ * the best moves so far; quit also stops the searches before it is queued, and any command stops
+ * a running analysis
+ */
+class gtp_shell {
+public:
+	gtp_shell(statistics& stats, const std::string& black_args, const std::string& white_args,
+			const std::string& name, const std::string& version) : stats(stats),
+		black("name=black " + black_args + " role=black"), white("name=white " + white_args + " role=white"),
+		name(name), version(version), out(&std::cout), issued(0), stopped(0), pending(0), done(false), analyzing(false) {}
+
+public:
+	/**
+	 * read commands until quit, the end of input, or the engine terminates the shell
+	 */
+	void run(std::istream& in, std::ostream& out) {
+		this->out = &out;
+		std::thread engine(&gtp_shell::serve, this);
+		for (std::string command; std::getline(in, command); ) {
+			if (command.size() && command.back() == '\r') command.pop_back();
+			if (command.empty()) continue;
+
+			std::vector<std::string> args;
+			std::istringstream iss(command);
+			for (std::string s; getline(iss, s, ' '); args.push_back(s));
+			std::string id;
+			if (args.size() > 1 && args[0].find_first_not_of("0123456789") == std::string::npos) {
+				id = args[0];
+				args.erase(args.begin());
+			}
+
+			std::unique_lock<std::mutex> lock(queue_lock);
+			if (done) break; // the engine has terminated the shell
+			if (args[0] == "stop" || args[0] == "quit" || analyzing) { // any command ends the analysis
+				analyzing = false;
+				stopped = issued;
+				black.interrupt();
+				white.interrupt();
+			}
+			if (args[0] == "quit") {
+				queue.push_back({ ++issued, id, args });
+				pending++;
+				ready.notify_one();
+				break;
+			}
+			if (args[0] == "analyze") analyzing = true;
+			bool ordered = id.empty() && pending; // whether the reply must wait for the pending replies
+			lock.unlock();
+
+			std::string reply;
+			if (!ordered && immediate(args, reply)) {
+				respond(reply, id);
+			} else {
+				lock.lock();
+				queue.push_back({ ++issued, id, args });
+				pending++;
+				ready.notify_one();
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(queue_lock);
+			queue.push_back({ ++issued, "", std::vector<std::string>() }); // the end of input
+			ready.notify_one();
+		}
+		engine.join();
+	}
+
+protected:
+	/**
+	 * handle a command that does not wait for the engine, return false if it should be queued
+	 */
+	bool immediate(const std::vector<std::string>& args, std::string& reply) {
+		if (args[0] == "stop") { // interrupt the searches, which is done by the reader
+			return true;
+		} else if (args[0] == "showboard") { // print the board
+			std::stringstream buf;
+			{
+				std::lock_guard<std::mutex> lock(state_lock);
+				buf << (stats.is_episode_ongoing() ? stats.back().state() : board());
+			}
+			reply = "\n" + buf.str();
+			reply.pop_back(); // remove a new line
+			return true;
+		} else if (args[0] == "name") { // report the name of the program
+			reply = name;
+			return true;
+		} else if (args[0] == "version") { // report the version number of the program
+			reply = version;
+			return true;
+		} else if (args[0] == "protocol_version") { // report GTP protocol version
+			reply = "2";
+			return true;
+		} else if (args[0] == "list_commands") { // print supported commands
+			reply = "play\n" "genmove\n" "clear_board\n" "showboard\n" "boardsize\n" "time_settings\n" "time_left\n"
+			        "analyze\n" "stop\n" "name\n" "version\n" "protocol_version\n" "list_commands\n" "quit\n";
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * the engine loop, which executes the queued commands in order, including the immediate commands
+	 * queued behind pending replies
+	 */
+	void serve() {
+		while (true) {
+			command cmd;
+			{
+				std::unique_lock<std::mutex> lock(queue_lock);
+				ready.wait(lock, [&]() { return queue.size(); });
+				cmd = std::move(queue.front());
+				queue.pop_front();
+				black.interrupt(cmd.seq <= stopped);
+				white.interrupt(cmd.seq <= stopped);
+			}
+			const std::vector<std::string>& args = cmd.args;
+			if (args.empty()) break; // the end of input
+			std::string reply;
+			bool alive = true;
+			if (args[0] == "analyze") {
+				analyze(args, cmd.id);
+			} else if (immediate(args, reply)) {
+				respond(reply, cmd.id);
+			} else {
+				alive = execute(args, reply);
+				if (alive || reply.size()) respond(reply, cmd.id);
+			}
+			std::lock_guard<std::mutex> lock(queue_lock);
+			pending--;
+			if (!alive) break;
+		}
+		std::lock_guard<std::mutex> lock(queue_lock);
+		done = true;
+	}
+
+	/**
+	 * execute a command on the engine, return false if the shell should be terminated
+	 */
+	bool execute(const std::vector<std::string>& args, std::string& reply) {
+		if (args[0] == "play" || args[0] == "genmove") { // play a move, or generate a move and play
+			std::unique_lock<std::mutex> lock(state_lock);
+			if (!stats.is_episode_ongoing()) { // should open an episode
+				black.open_episode("~:" + white.name());
+				white.open_episode(black.name() + ":~");
+				stats.open_episode(black.name() + ":" + white.name());
+			}
+
+			episode& game = stats.back();
+			agent& who = game.take_turns(black, white);
+			if (who.role()[0] != std::tolower(args[1][0])) { // player mismatch?!
+				reply = "resign";
+				// show the error message and terminate the shell
+				std::cerr << "player color " << args[1] << " mismatch!" << std::endl;
+				std::cerr << "current state, "
+				          << who.role() << " to play: " << std::endl << game.state();
+				return false;
+			}
+			if (args[0] == "play") { // play a move
+				std::string types = "?bw"; // black == 1, white == 2
+				action::place move(args[2], types.find(who.role()[0]));
+				if (game.apply_action(move) != true) { // remote plays an illegal move?!
+					reply = "resign";
+					// show the error message and terminate the shell
+					std::cerr << who.role() << " plays an illegal action!" << std::endl;
+					const char* reason[] = {
+						"legal",
+						"illegal_turn",
+						"illegal_pass",
+						"illegal_out_of_range",
+						"illegal_not_empty",
+						"illegal_suicide",
+						"illegal_take",
+						"unknown",
+					};
+					std::cerr << "current state: " << std::endl << game.state();
+					int code = move.apply(game.state());
+					std::cerr << "action: " << args[1] << " " << args[2] << std::endl;
+					std::cerr << "reason: " << reason[std::min(-code, 7)] << std::endl;
+					return false;
+				}
+			} else if (args[0] == "genmove") { // generate a move and play
+				unsigned color = game.state().info().who_take_turns;
+				if (clock.limited()) who.notify("budget=" + std::to_string(clock.budget(game.state())));
+				lock.unlock(); // only the engine changes the state, so the search needs no lock
+				auto start = std::chrono::steady_clock::now();
+				action::place move = who.take_action(game.state());
+				auto used = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+				if (clock.limited()) clock.spend(color, used.count());
+				lock.lock();
+				if (game.apply_action(move) == true) {
+					reply = move.position();
+				} else { // I have no legal move to play
+					reply = "resign";
+				}
+			}
+
+		} else if (args[0] == "clear_board" || args[0] == "quit") { // reset game, or quit
+			std::lock_guard<std::mutex> lock(state_lock);
+			if (stats.is_episode_ongoing()) { // should close an opened episode
+				agent& win = stats.back().last_turns(black, white);
+				stats.close_episode(win.name());
+				black.close_episode(win.name());
+				white.close_episode(win.name());
+			}
+			if (args[0] == "quit") return false; // quit GTP shell
+
+		} else if (args[0] == "time_settings") { // set the time control, in seconds
+			clock.settings(std::stod(args[1]) * 1000, std::stod(args[2]) * 1000, std::stoi(args[3]));
+
+		} else if (args[0] == "time_left") { // update the time left of a side, in seconds
+			unsigned color = std::tolower(args[1][0]) == 'b' ? board::black : board::white;
+			clock.left(color, std::stod(args[2]) * 1000, std::stoi(args[3]));
+
+		} else if (args[0] == "boardsize") { // set the board size
+			size_t size = std::stoul(args[1]);
+			if (size != board::size_x || size != board::size_y) {
+				std::cerr << "board size mismatch: " << args[1] << std::endl;
+			}
+			if (size > board::size_x || size > board::size_y) return false;
+
+		} else {
+			reply = "unknown command";
+		}
+		return true;
+	}
+
+	/**
+	 * analyze <color> <interval>, in the style of lz-analyze, where the interval is in centiseconds
+	 *
+	 * the search runs until the next command, and prints one line per interval as
+	 * info move D7 visits 120 winrate 5375 rave 5120 pv D7 E3 C2 info move ...
+	 * where the winrate and the RAVE value are of the given color, in 1/10000
+	 */
+	void analyze(const std::vector<std::string>& args, const std::string& id = "") {
+		board state;
+		{
+			std::lock_guard<std::mutex> lock(state_lock);
+			if (stats.is_episode_ongoing()) state = stats.back().state();
+		}
+		player& who = std::tolower(args.size() > 1 ? args[1][0] : 'b') == 'w' ? white : black;
+		time_t interval = (args.size() > 2 ? std::stoul(args[2]) : 100) * 10;
+		{
+			std::lock_guard<std::mutex> lock(output_lock);
+			*out << "=" << id << " " << std::endl;
+		}
+		who.analyze(state, interval, [&](const std::vector<player::child_report>& children) {
+			std::stringstream line;
+			for (const player::child_report& child : children) {
+				line << "info move " << std::string(board::point(child.move))
+				     << " visits " << child.visits
+				     << " winrate " << int(child.winrate * 10000)
+				     << " rave " << int(child.rave * 10000) << " pv";
+				for (int move : child.pv) line << ' ' << std::string(board::point(move));
+				line << ' ';
+			}
+			std::string info = line.str();
+			if (info.size()) info.pop_back();
+			std::lock_guard<std::mutex> lock(output_lock);
+			*out << info << std::endl;
+		});
+		std::lock_guard<std::mutex> lock(output_lock);
+		*out << std::endl;
+	}
+
+	void respond(const std::string& reply, const std::string& id = "") {
+		std::lock_guard<std::mutex> lock(output_lock);
+		*out << "=" << id << " " << reply << std::endl << std::endl;
+	}
+
+private:
+	statistics& stats;
+	player black, white;
+	timer clock; // the game clocks from time_settings and time_left
+	std::string name, version;
+	std::ostream* out;
+
+	struct command {
+		size_t seq; // the order of the command in the queue
+		std::string id; // the GTP id of the command, or empty
+		std::vector<std::string> args;
+	};
+	std::deque<command> queue; // the queued commands
+	size_t issued; // the sequence number of the last queued command
+	size_t stopped; // the commands with sequence numbers up to this are stopped
+	size_t pending; // the number of queued or running commands whose replies are not yet sent
+	bool done; // whether the engine has terminated
+	bool analyzing; // whether an analysis is queued or running
+	std::mutex queue_lock; // for the queue, the sequence numbers, the pending count and done
+	std::mutex state_lock; // for the episodes of the statistics
+	std::mutex output_lock;
+	std::condition_variable ready;
+};
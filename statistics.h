@@ -9,12 +9,85 @@
 
 #pragma once
 #include <deque>
+#include <array>
+#include <vector>
+#include <thread>
+#include <streambuf>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <mutex>
+#include <cmath>
+#include <memory>
+#include <fstream>
+#include <stdexcept>
 #include "board.h"
 #include "action.h"
 #include "episode.h"
+#include "record.h"
+
+/**
+ * histogram of non-negative values, exact for integers below 32 and log-bucketed above,
+ * with 16 buckets per power of two (about 4.4% resolution)
+ */
+class histogram {
+public:
+	histogram() : buckets(), num(0), top(0) {}
+
+public:
+	void add(double v) {
+		if (!(v >= 0) || std::isinf(v)) return;
+		buckets[std::min(index(v), buckets.size() - 1)]++;
+		num++;
+		top = std::max(top, v);
+	}
+	size_t size() const { return num; }
+	double max() const { return top; }
+
+	histogram& operator +=(const histogram& h) {
+		for (size_t i = 0; i < buckets.size(); i++) buckets[i] += h.buckets[i];
+		num += h.num;
+		top = std::max(top, h.top);
+		return *this;
+	}
+
+	/**
+	 * the lower bound of the bucket containing the p-quantile
+	 */
+	double quantile(double p) const {
+		size_t rank = std::max<size_t>(std::ceil(p * num), 1), sum = 0;
+		for (size_t i = 0; i < buckets.size() && num; i++) {
+			if ((sum += buckets[i]) >= rank) return std::min(bound(i), top);
+		}
+		return top;
+	}
+
+	/**
+	 * print as "p50 = 4, p95 = 6, p99 = 9, max = 14"
+	 */
+	friend std::ostream& operator <<(std::ostream& out, const histogram& h) {
+		return out << "p50 = " << h.quantile(0.50) << ", p95 = " << h.quantile(0.95)
+		           << ", p99 = " << h.quantile(0.99) << ", max = " << h.max();
+	}
+
+protected:
+	static size_t index(double v) {
+		return v < 32 ? size_t(v) : 32 + size_t((std::log2(v) - 5) * 16);
+	}
+	static double bound(size_t i) {
+		return i < 32 ? i : std::exp2(5 + (i - 32) / 16.0);
+	}
+
+private:
+	std::array<size_t, 32 + 16 * 40> buckets;
+	size_t num;
+	double top;
+};
 
 class statistics {
 public:
@@ -29,11 +102,15 @@ public:
 		: total(total),
 		  block(block ? block : total),
 		  limit(limit ? limit : total),
-		  count(0) {}
+		  count(0),
+		  issued(0),
+		  skip(0),
+		  test({}) {}
 
 public:
 	/**
-	 * show the statistics of last 'block' games
+	 * show the statistics of last 'block' games in memory
+	 * note that the block reports are made from the counters of the current block, without walking the episodes
 	 *
 	 * the format is
 	 * 1000   win = 53.5%|46.5%, op = 74.451 (37.493|36.958), ops = 125762 (132018|135377)
@@ -49,41 +126,152 @@ public:
 	 *                                  the average speed of white is 135377
 	 */
 	void show(size_t blk = 0) const {
-		size_t num = std::min(data.size(), blk ?: block);
-		size_t sop = 0, Bop = 0, Wop = 0;
-		time_t sdu = 0, Bdu = 0, Wdu = 0;
-		size_t BW = 0, WW = 0;
-		auto it = data.end();
-		for (size_t i = 0; i < num; i++) {
-			auto& ep = *(--it);
-			if (ep.step() % 2 == 1) BW++;
-			else                    WW++;
-			sop += ep.step();
-			Bop += ep.step(action::black::type);
-			Wop += ep.step(action::white::type);
-			sdu += ep.time();
-			Bdu += ep.time(action::black::type);
-			Wdu += ep.time(action::white::type);
+		size_t num = std::min(size(), blk ?: block);
+		tally sum;
+		episode buf;
+		for (size_t i = size() - num; i < size(); i++) sum.add(fetch(i, buf));
+		show(sum);
+	}
+
+	/**
+	 * the aggregate counters of a set of episodes
+	 */
+	struct tally {
+		size_t games, black_wins, white_wins;
+		size_t ops, black_ops, white_ops;
+		time_t duration, black_duration, white_duration;
+		tally() : games(0), black_wins(0), white_wins(0), ops(0), black_ops(0), white_ops(0),
+		          duration(0), black_duration(0), white_duration(0) {}
+
+		void add(const episode& ep) {
+			games++;
+			if (ep.step() % 2 == 1) black_wins++;
+			else                    white_wins++;
+			ops += ep.step();
+			black_ops += ep.step(action::black::type);
+			white_ops += ep.step(action::white::type);
+			duration += ep.time();
+			black_duration += ep.time(action::black::type);
+			white_duration += ep.time(action::white::type);
+		}
+		tally& operator +=(const tally& t) {
+			games += t.games, black_wins += t.black_wins, white_wins += t.white_wins;
+			ops += t.ops, black_ops += t.black_ops, white_ops += t.white_ops;
+			duration += t.duration, black_duration += t.black_duration, white_duration += t.white_duration;
+			return *this;
 		}
+	};
 
+	void show(const tally& sum) const {
+		size_t num = sum.games;
 		std::cout << count << "\t";
-		std::cout << "win = " << (BW * 100.0 / num) << "%"
-		          <<      "|" << (WW * 100.0 / num) << "%, ";
-		std::cout << "op = "  << (sop * 1.0 / num)
-		          <<     " (" << (Bop * 1.0 / num)
-		          <<      "|" << (Wop * 1.0 / num) << "), ";
-		std::cout << "ops = " << (sop * 1000.0 / sdu)
-		          <<     " (" << (Bop * 1000.0 / Bdu)
-		          <<      "|" << (Wop * 1000.0 / Wdu) << ")";
+		std::cout << "win = " << (sum.black_wins * 100.0 / num) << "%"
+		          <<      "|" << (sum.white_wins * 100.0 / num) << "%, ";
+		std::cout << "op = "  << (sum.ops * 1.0 / num)
+		          <<     " (" << (sum.black_ops * 1.0 / num)
+		          <<      "|" << (sum.white_ops * 1.0 / num) << "), ";
+		std::cout << "ops = " << (sum.ops * 1000.0 / sum.duration)
+		          <<     " (" << (sum.black_ops * 1000.0 / sum.black_duration)
+		          <<      "|" << (sum.white_ops * 1000.0 / sum.white_duration) << ")";
 		std::cout << std::endl;
 	}
 
+	/**
+	 * the latency distributions of all episodes
+	 */
+	struct latency {
+		histogram length; // moves per game
+		histogram black_think, white_think; // thinking time per move in milliseconds
+		histogram black_speed, white_speed; // moves per second of each game
+#ifdef COUNTERS
+		std::array<histogram, counters::events> move_work, game_work; // hot-path events per move and per game
+#endif
+
+		void add(const episode& ep) {
+			length.add(ep.step());
+			for (time_t t : ep.times(action::black::type)) black_think.add(t);
+			for (time_t t : ep.times(action::white::type)) white_think.add(t);
+			black_speed.add(ep.step(action::black::type) * 1000.0 / ep.time(action::black::type));
+			white_speed.add(ep.step(action::white::type) * 1000.0 / ep.time(action::white::type));
+#ifdef COUNTERS
+			counters::sample sum;
+			for (const counters::sample& w : ep.work()) {
+				for (unsigned e = 0; e < counters::events; e++) move_work[e].add(w.count[e]);
+				sum += w;
+			}
+			for (unsigned e = 0; e < counters::events && ep.work().size(); e++) game_work[e].add(sum.count[e]);
+#endif
+		}
+		latency& operator +=(const latency& l) {
+			length += l.length;
+			black_think += l.black_think, white_think += l.white_think;
+			black_speed += l.black_speed, white_speed += l.white_speed;
+#ifdef COUNTERS
+			for (unsigned e = 0; e < counters::events; e++) move_work[e] += l.move_work[e], game_work[e] += l.game_work[e];
+#endif
+			return *this;
+		}
+	};
+
+	/**
+	 * show the statistics and the latency distributions of all games
+	 *
+	 * the format is
+	 * 1000   win = 53.5%|46.5%, op = 74.451 (37.493|36.958), ops = 125762 (132018|135377)
+	 * length   p50 = 64, p95 = 72.4, p99 = 75.6, max = 79
+	 * black    think: p50 = 4, p95 = 7, p99 = 9, max = 15, ops: p50 = 238.9, p95 = 284.8, p99 = 297.3, max = 301.2
+	 * white    think: p50 = 1, p95 = 2, p99 = 2, max = 3, ops: p50 = 16000, p95 = 31000, p99 = 31000, max = 32000
+	 *
+	 * where 'length' is the number of moves per game, 'think' is the thinking time per move in milliseconds,
+	 * and 'ops' is the moves per second of each game (skipped if it took no measurable time);
+	 * a quantile is the lower bound of its bucket
+	 *
+	 * when compiled with -DCOUNTERS, the total of each hot-path event over all threads is also shown with its
+	 * averages, followed by its distributions per move and per game of the episodes played by this process, e.g.,
+	 * board_copy     1234567 (1929.01/op, 123456/game)
+	 *   move: p50 = 1880, p95 = 2304, p99 = 2432, max = 2598, game: p50 = 122880, p95 = 131072, p99 = 135168, max = 138001
+	 */
 	void summary() const {
-		show(data.size());
+		show(overall);
+		std::cout << "length\t" << profile.length << std::endl;
+		std::cout << "black\tthink: " << profile.black_think << ", ops: " << profile.black_speed << std::endl;
+		std::cout << "white\tthink: " << profile.white_think << ", ops: " << profile.white_speed << std::endl;
+#ifdef COUNTERS
+		for (unsigned e = 0; e < counters::events; e++) {
+			uint64_t n = counters::at(e);
+			std::cout << counters::name(e) << "\t" << n << " (" << (n * 1.0 / overall.ops) << "/op, "
+			          << (n * 1.0 / overall.games) << "/game)" << std::endl;
+			std::cout << "  move: " << profile.move_work[e] << ", game: " << profile.game_work[e] << std::endl;
+		}
+#endif
 	}
 
 	bool is_finished() const {
-		return count >= total;
+		return count >= total || test.result;
+	}
+
+	/**
+	 * enable the sequential probability ratio test on the win/loss record of black against white
+	 * the run is finished as soon as either hypothesis is accepted, or the total is reached
+	 *
+	 * H0: the elo difference of black over white is elo0
+	 * H1: the elo difference of black over white is elo1
+	 * alpha and beta are the false positive and false negative rates, respectively
+	 * elo0 must be less than elo1, and alpha and beta must be in (0, 1), otherwise the test never decides
+	 */
+	void sprt(double elo0, double elo1, double alpha = 0.05, double beta = 0.05) {
+		if (!(elo0 < elo1))
+			throw std::invalid_argument("invalid sprt: elo0 must be less than elo1");
+		if (!(alpha > 0 && alpha < 1 && beta > 0 && beta < 1))
+			throw std::invalid_argument("invalid sprt: alpha and beta must be in (0, 1)");
+		auto score = [](double elo) { return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0)); };
+		double p0 = score(elo0), p1 = score(elo1);
+		test.win = std::log(p1 / p0);
+		test.loss = std::log((1 - p1) / (1 - p0));
+		test.lower = std::log(beta / (1 - alpha));
+		test.upper = std::log((1 - beta) / alpha);
+		test.llr = 0;
+		test.enabled = true;
 	}
 
 	bool is_episode_ongoing() const {
@@ -91,21 +279,43 @@ public:
 	}
 
 	void open_episode(const std::string& flag = "") {
-		if (count++ >= limit) data.pop_front();
+		if (count++ >= limit) drop();
 		data.emplace_back();
 		data.back().open_episode(flag);
 	}
 
 	void close_episode(const std::string& flag = "") {
 		data.back().close_episode(flag);
-		if (count % block == 0) show();
+		settle();
 	}
 
-	episode& at(size_t i) {
-		return data.at(i);
+	/**
+	 * reserve a game for a worker thread, return false if no more games should be started
+	 */
+	bool claim_episode() {
+		std::lock_guard<std::mutex> guard(mutex);
+		if (issued >= total || test.result) return false;
+		issued++;
+		return true;
 	}
-	episode& front() {
-		return data.front();
+
+	/**
+	 * record a finished episode played by a worker thread
+	 * the block and limit semantics are the same as open_episode and close_episode
+	 */
+	void commit_episode(episode&& ep) {
+		std::lock_guard<std::mutex> guard(mutex);
+		if (count++ >= limit) drop();
+		data.push_back(std::move(ep));
+		settle();
+	}
+
+	/**
+	 * the i-th episode in memory, where a loaded record is decoded on demand
+	 */
+	episode at(size_t i) const {
+		episode buf;
+		return fetch(i, buf);
 	}
 	episode& back() {
 		return data.back();
@@ -113,8 +323,104 @@ public:
 	size_t step() const {
 		return count;
 	}
+	size_t size() const { // the number of episodes in memory, including the records of a loaded record file
+		return archived() + data.size();
+	}
+
+	/**
+	 * append each episode to a binary record file as soon as it is closed
+	 */
+	void record(const std::string& path) {
+		writer.reset(new record_writer(path));
+	}
+
+	/**
+	 * write each episode to a file as soon as it is closed, and drop it from memory
+	 * only the aggregate counters are kept, so that the memory usage does not grow with the total
+	 * note that the episodes in memory, e.g., loaded ones, are written to the file first
+	 */
+	void stream(const std::string& path) {
+		output.reset(new std::ofstream(path, std::ios::out | std::ios::trunc));
+		if (!*output) throw std::runtime_error("cannot open " + path);
+		*output << *this;
+		archive.reset();
+		data.clear();
+	}
+
+	bool is_streaming() const {
+		return output != nullptr;
+	}
+
+	/**
+	 * load the episodes from a binary record file, which stays mapped and is decoded on demand,
+	 * so that the loaded records take no memory as episodes; they come before the episodes played later
+	 */
+	void load(std::shared_ptr<const record_reader> reader, size_t threads = 1) {
+		archive = std::move(reader);
+		skip = 0;
+		total = std::max(total, size());
+		count = size();
+		issued = count;
+		recount(threads);
+	}
+
+	/**
+	 * load the episodes from a text file with multiple threads
+	 * the file is mapped into memory and split at line boundaries, and each thread parses a contiguous range
+	 * of lines into a preallocated container, so that the order of the episodes is preserved
+	 * as the stream loader, the episodes end at the first empty line
+	 */
+	void load(const std::string& path, size_t threads = 1) {
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) return;
+		struct stat st;
+		fstat(fd, &st);
+		size_t length = st.st_size;
+		void* base = length ? mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		::close(fd);
+		if (base == MAP_FAILED) return;
+		madvise(base, length, MADV_SEQUENTIAL);
+
+		std::vector<std::pair<const char*, const char*>> lines;
+		const char* end = static_cast<const char*>(base) + length;
+		for (const char* it = static_cast<const char*>(base); it < end; ) {
+			const char* eol = static_cast<const char*>(std::memchr(it, '\n', end - it));
+			if (!eol) eol = end;
+			if (eol == it || (eol == it + 1 && *it == '\r')) break;
+			lines.emplace_back(it, eol);
+			it = eol + 1;
+		}
+
+		struct membuf : std::streambuf {
+			membuf(const char* begin, const char* end) {
+				setg(const_cast<char*>(begin), const_cast<char*>(begin), const_cast<char*>(end));
+			}
+		};
+		std::vector<episode> eps(lines.size());
+		threads = std::max<size_t>(std::min(threads, lines.size()), 1);
+		auto parse = [&](size_t k) {
+			for (size_t i = lines.size() * k / threads; i < lines.size() * (k + 1) / threads; i++) {
+				membuf buf(lines[i].first, lines[i].second);
+				std::istream in(&buf);
+				in >> eps[i];
+			}
+		};
+		std::vector<std::thread> pool;
+		for (size_t k = 1; k < threads; k++) pool.emplace_back(parse, k);
+		parse(0);
+		for (std::thread& th : pool) th.join();
+		munmap(base, length);
+
+		data.insert(data.end(), std::make_move_iterator(eps.begin()), std::make_move_iterator(eps.end()));
+		total = std::max(total, size());
+		count = size();
+		issued = count;
+		recount(threads);
+	}
 
 	friend std::ostream& operator <<(std::ostream& out, const statistics& stat) {
+		episode buf;
+		for (size_t i = 0; i < stat.archived(); i++) out << stat.fetch(i, buf) << std::endl;
 		for (const episode& rec : stat.data) out << rec << std::endl;
 		return out;
 	}
@@ -123,15 +429,119 @@ public:
 			stat.data.emplace_back();
 			std::stringstream(line) >> stat.data.back();
 		}
-		stat.total = std::max(stat.total, stat.data.size());
-		stat.count = stat.data.size();
+		stat.total = std::max(stat.total, stat.size());
+		stat.count = stat.size();
+		stat.issued = stat.count;
+		stat.recount();
 		return in;
 	}
 
+protected:
+	/**
+	 * handle the last closed episode: append it to the record file, update the sequential probability ratio test,
+	 * write it to the stream and drop it from memory if streaming, and show the statistics at the end of a block
+	 */
+	void settle() {
+		const episode& ep = data.back();
+		if (writer) writer->append(ep);
+		judge(ep);
+		overall.add(ep);
+		window.add(ep);
+		profile.add(ep);
+		if (output) {
+			*output << ep << std::endl;
+			data.pop_back();
+		}
+		if (count % block == 0) show(window), window = {};
+	}
+
+	/**
+	 * recalculate the counters from the loaded episodes with multiple threads,
+	 * where the current block consists of the last (count % block) episodes
+	 */
+	void recount(size_t threads = 1) {
+		size_t n = size();
+		threads = std::max<size_t>(std::min(threads, n), 1);
+		std::vector<tally> sums(threads);
+		std::vector<latency> profiles(threads);
+		auto accumulate = [&](size_t k) {
+			episode buf;
+			for (size_t i = n * k / threads; i < n * (k + 1) / threads; i++) {
+				const episode& ep = fetch(i, buf);
+				sums[k].add(ep);
+				profiles[k].add(ep);
+			}
+		};
+		std::vector<std::thread> pool;
+		for (size_t k = 1; k < threads; k++) pool.emplace_back(accumulate, k);
+		accumulate(0);
+		for (std::thread& th : pool) th.join();
+
+		overall = {}, window = {}, profile = {};
+		for (size_t k = 0; k < threads; k++) overall += sums[k], profile += profiles[k];
+		size_t tail = std::min(block ? count % block : 0, n);
+		episode buf;
+		for (size_t i = n - tail; i < n; i++) window.add(fetch(i, buf));
+	}
+
+	/**
+	 * the number of the loaded records still in memory, which come before the episodes in data
+	 */
+	size_t archived() const {
+		return archive ? archive->size() - skip : 0;
+	}
+
+	/**
+	 * the i-th episode in memory, where a loaded record is decoded into the buffer
+	 */
+	const episode& fetch(size_t i, episode& buf) const {
+		if (i >= archived()) return data.at(i - archived());
+		archive->decode(skip + i, buf);
+		return buf;
+	}
+
+	/**
+	 * drop the oldest episode in memory, which is a loaded record if there is any
+	 */
+	void drop() {
+		if (archived()) skip++;
+		else if (data.size()) data.pop_front();
+	}
+
+	/**
+	 * update the log-likelihood ratio of the test with a closed episode, and check the bounds
+	 */
+	void judge(const episode& ep) {
+		if (!test.enabled || test.result) return;
+		test.llr += (ep.step() % 2 == 1) ? test.win : test.loss;
+		if (test.llr >= test.upper) test.result = +1;
+		if (test.llr <= test.lower) test.result = -1;
+		if (test.result) {
+			std::cout << "SPRT: H" << (test.result > 0 ? 1 : 0) << " accepted after " << count << " games, "
+			          << "llr = " << test.llr << " (" << test.lower << ", " << test.upper << ")" << std::endl;
+		}
+	}
+
 private:
 	size_t total;
 	size_t block;
 	size_t limit;
 	size_t count;
+	size_t issued;
 	std::deque<episode> data;
+	std::shared_ptr<const record_reader> archive; // the loaded record file, whose first 'skip' records are dropped
+	size_t skip;
+	std::mutex mutex;
+	std::unique_ptr<record_writer> writer;
+	std::unique_ptr<std::ofstream> output;
+	tally overall; // of all episodes
+	tally window; // of the episodes in the current block
+	latency profile; // of all episodes
+
+	struct {
+		bool enabled;
+		int result; // +1 for H1, -1 for H0, 0 for undecided
+		double llr, lower, upper;
+		double win, loss; // llr increments of a black win and a white win
+	} test;
 };
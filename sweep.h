@@ -0,0 +1,167 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * sweep.h: Parallel parameter sweep over player configurations
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include "agent.h"
+#include "episode.h"
+#include "arena.h"
+
+/**
+ * a sweep plays a number of games for each configuration, i.e., a pair of black and white arguments,
+ * and reports the win rate of black with its 95% Wilson interval, and the moves per second
+ *
+ * configurations are given one per line as "black args | white args", where blank lines and lines
+ * starting with '#' are skipped, and a line with alternatives in braces expands to their grid, e.g.,
+ *
+ *   search=MCTS simulation={100,200} rave={0.01,0.025} | search=MCTS simulation=200
+ *
+ * gives 4 configurations; all games of all configurations are scheduled on one pool of threads,
+ * taken in turns so that the configurations progress evenly, and the seeds of the players are
+ * derived from the game index, so the result does not depend on the number of threads
+ */
+class sweep {
+public:
+	sweep() {}
+
+	struct config {
+		std::string black_args, white_args;
+		size_t games = 0, wins = 0; // the number of games, and those won by black
+		size_t moves = 0; // the total number of moves
+		double seconds = 0; // the total time of the games
+	};
+
+public:
+	/**
+	 * add the configurations of a line, return the number of configurations added
+	 */
+	size_t add(const std::string& line) {
+		std::string text = line.substr(0, line.find_last_not_of(" \t\r") + 1);
+		if (text.empty() || text[text.find_first_not_of(" \t")] == '#') return 0;
+		std::vector<std::string> lines;
+		expand(text, lines);
+		for (const std::string& l : lines) {
+			size_t bar = l.find('|');
+			config c;
+			c.black_args = trim(l.substr(0, bar));
+			c.white_args = bar != std::string::npos ? trim(l.substr(bar + 1)) : "";
+			player::check("name=black " + c.black_args + " role=black", "--sweep"); // check the arguments before running
+			player::check("name=white " + c.white_args + " role=white", "--sweep");
+			configs.push_back(c);
+		}
+		return lines.size();
+	}
+
+	void load(std::istream& in) {
+		for (std::string line; std::getline(in, line); add(line));
+	}
+
+	/**
+	 * play the given number of games for each configuration on the given number of threads, then print the table
+	 */
+	void run(std::ostream& out, size_t games, size_t threads = 1) {
+		std::atomic<size_t> next(0);
+		size_t jobs = games * configs.size();
+		std::mutex mutex;
+
+		auto worker = [&]() {
+			for (size_t job; (job = next++) < jobs; ) {
+				config& c = configs[job % configs.size()];
+				size_t index = job / configs.size();
+				player black("name=black " + arena::seeded(c.black_args, index) + " role=black");
+				player white("name=white " + arena::seeded(c.white_args, index) + " role=white");
+				episode game;
+				auto start = std::chrono::steady_clock::now();
+				arena::play(game, black, white);
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				bool win = &game.last_turns(black, white) == &black;
+
+				std::lock_guard<std::mutex> lock(mutex);
+				c.games += 1;
+				c.wins += win ? 1 : 0;
+				c.moves += game.step();
+				c.seconds += seconds;
+			}
+		};
+
+		std::vector<std::thread> pool;
+		for (size_t k = 1; k < std::max<size_t>(threads, 1); k++) pool.emplace_back(worker);
+		worker();
+		for (std::thread& th : pool) th.join();
+		summary(out);
+	}
+
+	/**
+	 * print one row per configuration, separated by tabs
+	 */
+	void summary(std::ostream& out) const {
+		out << "#\tgames\twin\t95% CI\tmoves/s\tblack\twhite" << std::endl;
+		for (size_t k = 0; k < configs.size(); k++) {
+			const config& c = configs[k];
+			double low, high;
+			wilson(c.wins, c.games, low, high);
+			out << k << "\t" << c.games << std::fixed << std::setprecision(1)
+			    << "\t" << (c.games ? 100.0 * c.wins / c.games : 0) << "%"
+			    << "\t" << (100 * low) << "%-" << (100 * high) << "%"
+			    << "\t" << (c.seconds > 0 ? c.moves / c.seconds : 0)
+			    << "\t" << c.black_args << "\t" << c.white_args << std::endl;
+			out.unsetf(std::ios::floatfield);
+		}
+	}
+
+	const std::vector<config>& results() const { return configs; }
+
+protected:
+	/**
+	 * expand the first group of alternatives in braces recursively
+	 */
+	static void expand(const std::string& line, std::vector<std::string>& lines) {
+		size_t open = line.find('{'), close = line.find('}', open);
+		if (open == std::string::npos || close == std::string::npos) {
+			lines.push_back(line);
+			return;
+		}
+		std::stringstream ss(line.substr(open + 1, close - open - 1));
+		for (std::string alt; std::getline(ss, alt, ','); )
+			expand(line.substr(0, open) + trim(alt) + line.substr(close + 1), lines);
+	}
+
+	static std::string trim(const std::string& s) {
+		size_t begin = s.find_first_not_of(" \t"), end = s.find_last_not_of(" \t");
+		return begin != std::string::npos ? s.substr(begin, end - begin + 1) : "";
+	}
+
+	/**
+	 * the 95% Wilson score interval of a win rate
+	 */
+	static void wilson(size_t wins, size_t games, double& low, double& high) {
+		if (!games) {
+			low = 0, high = 1;
+			return;
+		}
+		const double z = 1.96;
+		double n = games, p = wins / n;
+		double center = (p + z * z / (2 * n)) / (1 + z * z / n);
+		double half = z * std::sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / (1 + z * z / n);
+		low = std::max(center - half, 0.0);
+		high = std::min(center + half, 1.0);
+	}
+
+private:
+	std::vector<config> configs;
+};
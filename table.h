@@ -0,0 +1,111 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * table.h: Transposition table in POSIX shared memory for multi-process search
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+/**
+ * a transposition table of the visit count and the value sum of positions, shared by forked processes
+ *
+ * the table is a POSIX shared memory object, which is unlinked once mapped, so it is released with
+ * the last process that maps it; the entries are updated without locks, where each entry keeps
+ * (key ^ data) next to its data, and a torn entry, written by two processes at the same time, fails
+ * the check and is taken as a miss; an update may also be lost in such a race, which only costs
+ * a little information of the search
+ *
+ * the table is direct mapped by the low bits of the key, and a new position replaces the old one
+ */
+class shared_table {
+public:
+	/**
+	 * a table of about the given size in megabytes, rounded down to a power of two entries
+	 */
+	shared_table(size_t megabytes = 16) : entries(nullptr), mask(0), bytes(0) {
+		size_t n = 1;
+		while (n * 2 * sizeof(entry) <= std::max<size_t>(megabytes, 1) << 20) n *= 2;
+		bytes = n * sizeof(entry);
+		mask = n - 1;
+
+		static std::atomic<unsigned> serial(0);
+		std::string name = "/nogo-" + std::to_string(getpid()) + "-" + std::to_string(serial++);
+		int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0) throw std::runtime_error("shm_open failed: " + name);
+		void* mem = MAP_FAILED;
+		if (ftruncate(fd, bytes) == 0)
+			mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+		shm_unlink(name.c_str());
+		if (mem == MAP_FAILED) throw std::runtime_error("cannot map shared memory: " + name);
+		entries = static_cast<entry*>(mem); // the object is zero filled, i.e., all entries are empty
+	}
+	~shared_table() { munmap(entries, bytes); }
+
+	shared_table(const shared_table&) = delete;
+	shared_table& operator =(const shared_table&) = delete;
+
+public:
+	/**
+	 * the visit count and the value sum of a position, return false if it is not in the table
+	 */
+	bool find(uint64_t key, uint32_t& count, uint64_t& value) const {
+		const entry& e = entries[key & mask];
+		uint64_t data = e.data.load(std::memory_order_relaxed);
+		if ((e.check.load(std::memory_order_relaxed) ^ data) != key || !data) return false;
+		count = data & count_mask;
+		value = data >> count_bits;
+		return true;
+	}
+
+	/**
+	 * add visits and values to a position, where the count and the value are halved together when
+	 * either would overflow its field, so that the mean is kept
+	 */
+	void add(uint64_t key, uint32_t count, uint64_t value) {
+		entry& e = entries[key & mask];
+		uint64_t data = e.data.load(std::memory_order_relaxed);
+		uint64_t n = count;
+		if ((e.check.load(std::memory_order_relaxed) ^ data) == key && data) {
+			n += data & count_mask;
+			value += data >> count_bits;
+		}
+		while (n > count_mask || value > value_mask)
+			n = (n + 1) / 2, value /= 2;
+		data = (value << count_bits) | n;
+		e.data.store(data, std::memory_order_relaxed);
+		e.check.store(key ^ data, std::memory_order_relaxed);
+	}
+
+	void clear() {
+		std::memset(static_cast<void*>(entries), 0, bytes);
+	}
+
+	size_t size() const { return mask + 1; }
+
+private:
+	struct entry {
+		std::atomic<uint64_t> check; // key ^ data
+		std::atomic<uint64_t> data; // the value sum in the high 40 bits, and the count in the low 24 bits
+	};
+	static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the entries must be lock free to be shared by processes");
+	static constexpr int count_bits = 24;
+	static constexpr uint64_t count_mask = (uint64_t(1) << count_bits) - 1;
+	static constexpr uint64_t value_mask = (uint64_t(1) << (64 - count_bits)) - 1;
+
+	entry* entries;
+	size_t mask;
+	size_t bytes;
+};
@@ -0,0 +1,105 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * timer.h: Game clocks and per-move time budgets for the GTP shell
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <algorithm>
+#include <ctime>
+#include "board.h"
+
+/**
+ * the clocks of both sides under the GTP time system, i.e., main time followed by Canadian byo-yomi
+ * all times are in milliseconds
+ */
+class timer {
+public:
+	timer(time_t lag = 20) : lag(lag), main_time(0), byo_time(0), byo_stones(0), enabled(false) {}
+
+public:
+	/**
+	 * GTP time_settings, where byo_stones == 0 with byo_time > 0 means no time limit
+	 */
+	void settings(time_t main, time_t byo, int stones) {
+		main_time = main;
+		byo_time = byo;
+		byo_stones = stones;
+		enabled = !(byo_time > 0 && byo_stones == 0);
+		for (unsigned who : { board::black, board::white }) clock[who] = { main_time, 0, 0 };
+	}
+
+	/**
+	 * GTP time_left, where stones > 0 means the side is in byo-yomi with 'time' left for 'stones' stones
+	 */
+	void left(unsigned who, time_t time, int stones) {
+		if (stones > 0) clock[who] = { 0, time, stones };
+		else            clock[who] = { time, 0, 0 };
+	}
+
+	/**
+	 * account the time spent on a move, for controllers that do not send time_left
+	 */
+	void spend(unsigned who, time_t used) {
+		side& c = clock[who];
+		if (c.main > used) { c.main -= used; return; }
+		used -= c.main;
+		c.main = 0;
+		if (!byo_stones) return;
+		if (!c.stones) c = { 0, byo_time, byo_stones }; // enter byo-yomi
+		c.time = std::max<time_t>(c.time - used, 0);
+		if (--c.stones <= 0) c = { 0, byo_time, byo_stones }; // a new period
+	}
+
+	bool limited() const { return enabled; }
+
+	/**
+	 * the time budget of the side to move in the given state
+	 *
+	 * the main time is shared by the expected remaining moves of the side, estimated from its number
+	 * of legal moves, and is weighted toward the middle game; a position with few choices gets little,
+	 * and a forced move gets nothing. the byo-yomi time is shared by the stones of the current period
+	 */
+	time_t budget(const board& state) const {
+		unsigned who = state.info().who_take_turns;
+		const side& c = clock[who];
+		int choices = 0, stones = 0, cells = 0;
+		for (int i = 0; i < board::size_x * board::size_y; i++) {
+			if (state(i) == board::hollow) continue;
+			cells++;
+			if (state(i) != board::empty) { stones++; continue; }
+			board after = state;
+			if (after.place(board::move(i, who)) == board::legal) choices++;
+		}
+		if (choices <= 1) return 0;
+
+		double progress = double(stones) / cells;
+		double phase = 0.5 + 4 * progress * (1 - progress); // 0.5 at both ends, 1.5 in the middle
+		double choice = std::min(1.0, choices / 8.0);
+		double moves = std::max(choices / 2.0, 1.0) + reserve;
+		double budget = c.main / moves * phase * choice;
+		budget = std::min(budget, c.main / 4.0);
+
+		time_t byo = 0;
+		if (c.stones) byo = c.time / c.stones;
+		else if (byo_stones) byo = byo_time / byo_stones;
+		if (c.main < lag) budget = std::max(budget, byo * choice); // running on byo-yomi
+		return std::max<time_t>(time_t(budget) - lag, time_t(budget) / 2);
+	}
+
+private:
+	struct side {
+		time_t main; // main time left
+		time_t time; // byo-yomi time left in the current period, if stones > 0
+		int stones; // stones to be played in the current period
+	};
+	static constexpr double reserve = 4; // the spare moves kept in the main time
+	time_t lag; // the network and process overhead of a move
+	time_t main_time, byo_time;
+	int byo_stones;
+	bool enabled;
+	side clock[3];
+};
@@ -0,0 +1,189 @@
+/**
+ * Framework for NoGo and similar games (C++ 11)
+ * trainer.h: Supervised training of the network from an exported dataset
+ *
+ * Author: Theory of Computer Games
+ *         Computer Games and Intelligence (CGI) Lab, NYCU, Taiwan
+ *         https://cgilab.nctu.edu.tw/
+ */
+
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <stdexcept>
+#include "board.h"
+#include "network.h"
+#include "dataset.h"
+
+/**
+ * a trainer fits the network of network.h to the samples of a dataset by plain stochastic gradient
+ * descent, where the value head learns the game result by the logistic loss, and the policy head
+ * learns the visit distribution of the search by the cross entropy over the empty points
+ *
+ * the arguments are given as "key=value" pairs, where
+ *  'data' is the dataset file written by --export, and 'weights' is the network file to write
+ *  'hidden' is the number of hidden units (64 by default), 'epochs' the passes over the samples (4),
+ *  'rate' the learning rate (0.01), and 'seed' the seed of the initial weights and the order (1)
+ *
+ * the last tenth of the samples is held out, and the losses on it are printed after each epoch
+ */
+class trainer {
+public:
+	trainer(const std::string& args) {
+		std::map<std::string, std::string> meta = { { "hidden", "64" }, { "epochs", "4" }, { "rate", "0.01" }, { "seed", "1" } };
+		std::stringstream ss(args);
+		for (std::string pair; ss >> pair; )
+			meta[pair.substr(0, pair.find('='))] = pair.substr(pair.find('=') + 1);
+		if (!meta.count("data") || !meta.count("weights"))
+			throw std::invalid_argument("invalid train: " + args + ", expect data=<dataset> weights=<network>");
+		data = meta["data"];
+		weights = meta["weights"];
+		hidden = std::stoul(meta["hidden"]);
+		epochs = std::stoul(meta["epochs"]);
+		rate = std::stof(meta["rate"]);
+		seed = std::stoul(meta["seed"]);
+		if (hidden == 0) throw std::invalid_argument("invalid train: hidden must be positive");
+	}
+
+public:
+	void run(std::ostream& out) {
+		std::vector<dataset::sample> samples = dataset::read(data);
+		if (samples.empty()) throw std::invalid_argument("no sample in " + data);
+		size_t train = samples.size() >= 10 ? samples.size() - samples.size() / 10 : samples.size();
+		out << "train " << hidden << " hidden units on " << train << " samples, hold out "
+		    << samples.size() - train << " samples" << std::endl;
+
+		std::default_random_engine engine(seed);
+		init(engine);
+		std::vector<size_t> order(train);
+		std::iota(order.begin(), order.end(), 0);
+		out << std::fixed << std::setprecision(4);
+		for (size_t e = 1; e <= epochs; e++) {
+			std::shuffle(order.begin(), order.end(), engine);
+			loss fit, held;
+			for (size_t i : order) fit += step(samples[i], rate);
+			for (size_t i = train; i < samples.size(); i++) held += step(samples[i], 0);
+			out << "epoch " << e << ": value loss = " << fit.value / train << ", policy loss = " << fit.policy / train;
+			if (train < samples.size()) {
+				size_t n = samples.size() - train;
+				out << ", holdout value loss = " << held.value / n << ", policy loss = " << held.policy / n
+				    << ", result accuracy = " << double(held.correct) / n;
+			}
+			out << std::endl;
+		}
+		network::save(weights, hidden, w);
+		out << "saved " << weights << std::endl;
+	}
+
+protected:
+	struct loss {
+		double value = 0, policy = 0;
+		size_t correct = 0;
+		loss& operator +=(const loss& l) { value += l.value, policy += l.policy, correct += l.correct; return *this; }
+	};
+
+	/**
+	 * the offsets of the parts of the weights, in the order of the network file
+	 */
+	size_t w1() const { return 0; }
+	size_t b1() const { return network::inputs * hidden; }
+	size_t wv() const { return b1() + hidden; }
+	size_t bv() const { return wv() + hidden; }
+	size_t wp() const { return bv() + 1; }
+	size_t bp() const { return wp() + network::outputs * hidden; }
+
+	/**
+	 * the initial weights, scaled by the number of inputs of each unit, with zero biases
+	 */
+	void init(std::default_random_engine& engine) {
+		w.assign(bp() + network::outputs, 0);
+		std::normal_distribution<float> first(0, 1 / std::sqrt(float(network::cells)));
+		std::normal_distribution<float> second(0, 1 / std::sqrt(float(hidden)));
+		for (size_t k = w1(); k < b1(); k++) w[k] = first(engine);
+		for (size_t k = wv(); k < bv(); k++) w[k] = second(engine);
+		for (size_t k = wp(); k < bp(); k++) w[k] = second(engine);
+	}
+
+	/**
+	 * the losses of a sample, and a descent step on it if the rate is positive
+	 * the features follow network::features, i.e., the stones of the side to move, the stones of the
+	 * opponent and the empty points, and the hollow points have no input
+	 */
+	loss step(const dataset::sample& smp, float rate) {
+		const size_t cells = network::cells;
+		int active[cells], count = 0;
+		for (size_t i = 0; i < cells; i++) {
+			unsigned cell = smp.cells[i];
+			if (cell == board::hollow) continue;
+			int plane = cell == board::empty ? 2 : (cell == smp.color ? 0 : 1);
+			active[count++] = plane * cells + i;
+		}
+
+		std::vector<float> z(w.begin() + b1(), w.begin() + wv()), h(hidden);
+		for (int a = 0; a < count; a++)
+			for (size_t j = 0; j < hidden; j++) z[j] += w[w1() + active[a] * hidden + j];
+		for (size_t j = 0; j < hidden; j++) h[j] = std::max(z[j], 0.0f);
+
+		loss l;
+		double logit = w[bv()];
+		for (size_t j = 0; j < hidden; j++) logit += w[wv() + j] * h[j];
+		double v = 1 / (1 + std::exp(-logit)), y = smp.result > 0 ? 1 : 0;
+		l.value = -(y * std::log(std::max(v, 1e-12)) + (1 - y) * std::log(std::max(1 - v, 1e-12)));
+		l.correct = (v > 0.5) == (y > 0.5);
+
+		std::vector<double> p(cells, 0);
+		double max = -INFINITY, sum = 0;
+		for (size_t k = 0; k < cells; k++) {
+			if (smp.cells[k] != board::empty) continue;
+			p[k] = w[bp() + k];
+			for (size_t j = 0; j < hidden; j++) p[k] += w[wp() + k * hidden + j] * h[j];
+			max = std::max(max, p[k]);
+		}
+		for (size_t k = 0; k < cells; k++) if (smp.cells[k] == board::empty) sum += (p[k] = std::exp(p[k] - max));
+		for (size_t k = 0; k < cells; k++) {
+			if (smp.cells[k] != board::empty) continue;
+			p[k] /= sum;
+			if (smp.policy[k] > 0) l.policy -= smp.policy[k] * std::log(std::max(p[k], 1e-12));
+		}
+		if (rate <= 0) return l;
+
+		// back propagate with the weights before this step, then descend
+		std::vector<float> g(hidden);
+		float dv = v - y;
+		for (size_t j = 0; j < hidden; j++) g[j] = dv * w[wv() + j];
+		for (size_t k = 0; k < cells; k++) {
+			if (smp.cells[k] != board::empty) continue;
+			float dp = p[k] - smp.policy[k];
+			float* wk = &w[wp() + k * hidden];
+			for (size_t j = 0; j < hidden; j++) {
+				g[j] += dp * wk[j];
+				wk[j] -= rate * dp * h[j];
+			}
+			w[bp() + k] -= rate * dp;
+		}
+		for (size_t j = 0; j < hidden; j++) w[wv() + j] -= rate * dv * h[j];
+		w[bv()] -= rate * dv;
+		for (size_t j = 0; j < hidden; j++) {
+			if (z[j] <= 0) continue;
+			float gz = rate * g[j];
+			w[b1() + j] -= gz;
+			for (int a = 0; a < count; a++) w[w1() + active[a] * hidden + j] -= gz;
+		}
+		return l;
+	}
+
+private:
+	std::string data, weights;
+	size_t hidden, epochs;
+	float rate;
+	unsigned seed;
+	std::vector<float> w; // all weights in the order of the network file
+};